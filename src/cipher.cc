@@ -1,14 +1,22 @@
 #include "cipher.h"
 
+#include "multiexp.h"
+
 shf::SecretKey shf::CreateSecretKey() { return shf::Scalar::CreateRandom(); }
 
 shf::PublicKey shf::CreatePublicKey(const shf::SecretKey& sk) {
-  return shf::Point::Generator() * sk;
+  return shf::Point::MulGenerator(sk);
 }
 
 shf::Ctxt shf::Encrypt(const shf::PublicKey& pk, const shf::Point& m,
                      const shf::Scalar& r) {
-  const auto U = shf::Point::Generator() * r;
+  const auto U = shf::Point::MulGenerator(r);
+  return {U, m + r * pk};
+}
+
+shf::Ctxt shf::Encrypt(const shf::FixedBasePoint& pk, const shf::Point& m,
+                     const shf::Scalar& r) {
+  const auto U = shf::Point::MulGenerator(r);
   return {U, m + r * pk};
 }
 
@@ -29,10 +37,26 @@ shf::Ctxt shf::Multiply(const shf::Scalar& s, const shf::Ctxt& E) {
 }
 
 shf::Ctxt shf::Dot(const std::vector<shf::Scalar>& as,
-                 const std::vector<shf::Ctxt>& Es) {
-  shf::Ctxt E = shf::Multiply(as[0], Es[0]);
+                 const std::vector<shf::Ctxt>& Es, shf::ThreadPool* pool) {
   const auto n = as.size();
-  for (std::size_t i = 1; i < n; ++i)
-    E = shf::Add(E, shf::Multiply(as[i], Es[i]));
-  return E;
+  std::vector<const shf::Point*> Us, Vs;
+  Us.reserve(n);
+  Vs.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    Us.emplace_back(&Es[i].U);
+    Vs.emplace_back(&Es[i].V);
+  }
+  return {shf::MultiExp(as, Us, pool), shf::MultiExp(as, Vs, pool)};
+}
+
+void shf::Normalize(std::vector<shf::Ctxt>& Es, shf::ThreadPool* pool) {
+  shf::ParallelFor(pool, Es.size(), [&](std::size_t begin, std::size_t end) {
+    std::vector<shf::Point*> points;
+    points.reserve(2 * (end - begin));
+    for (std::size_t i = begin; i < end; ++i) {
+      points.emplace_back(&Es[i].U);
+      points.emplace_back(&Es[i].V);
+    }
+    shf::Point::NormalizeBatch(points);
+  });
 }
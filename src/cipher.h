@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "curve.h"
+#include "threadpool.h"
 
 namespace shf {
 
@@ -27,6 +28,16 @@ PublicKey CreatePublicKey(const SecretKey& sk);
  */
 Ctxt Encrypt(const PublicKey& pk, const Point& m, const Scalar& r);
 
+/**
+ * @brief Encrypt a message using provided randomness and a precomputed
+ * public key.
+ * @param pk the public key
+ * @param m the message
+ * @param r randomness
+ * @return a fresh encryption of m.
+ */
+Ctxt Encrypt(const FixedBasePoint& pk, const Point& m, const Scalar& r);
+
 /**
  * @brief Encrypt a message
  * @param pk the public key
@@ -63,9 +74,22 @@ Ctxt Add(const Ctxt& E0, const Ctxt& E1);
  * @brief Compute a "dot" product between a list of ciphertexts and scalars.
  * @param as the scalars
  * @param Es the ciphertexts
+ * @param pool optional thread pool to spread the work over
  * @return a ciphertext E defined as E = sum_i as[i]*Es[i].
  */
-Ctxt Dot(const std::vector<shf::Scalar>& as, const std::vector<Ctxt>& Es);
+Ctxt Dot(const std::vector<shf::Scalar>& as, const std::vector<Ctxt>& Es,
+         ThreadPool* pool = nullptr);
+
+/**
+ * @brief Bring a list of ciphertexts to affine coordinates.
+ *
+ * Uses a single field inversion for all points, which makes writing and
+ * hashing the ciphertexts, or using them in a multi exponentiation, cheaper.
+ *
+ * @param Es the ciphertexts
+ * @param pool optional thread pool to spread the work over
+ */
+void Normalize(std::vector<Ctxt>& Es, ThreadPool* pool = nullptr);
 
 }  // namespace mh
 
@@ -1,30 +1,91 @@
 #include "commit.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <stdexcept>
+#include <utility>
+
+#include "multiexp.h"
 
 shf::CommitKey shf::CreateCommitKey(const std::size_t size) {
   if (size == 0) throw std::invalid_argument("cannot create a key of size 0");
 
   CommitKey ck;
-  ck.G.reserve(size);
-  ck.H = Point::CreateRandom();
-  for (std::size_t i = 0; i < size; ++i)
-    ck.G.emplace_back(Point::CreateRandom());
+  std::vector<Point> G;
+  G.reserve(size);
+  ck.H = FixedBasePoint(Point::CreateRandom());
+  for (std::size_t i = 0; i < size; ++i) G.emplace_back(Point::CreateRandom());
+  ck.G = AffinePoints(std::move(G));
+  return ck;
+}
+
+// hash of (domain, seed, label, index) to the curve. H and G[i] use different
+// labels so that no generator can be one of the others.
+static inline shf::Point DeriveGenerator(const uint8_t* seed,
+                                         std::size_t seed_size, uint8_t label,
+                                         uint64_t index) {
+  static const char kDomain[] = "shf commit key";
+  std::vector<uint8_t> msg(kDomain, kDomain + sizeof(kDomain) - 1);
+  msg.insert(msg.end(), seed, seed + seed_size);
+  msg.emplace_back(label);
+  for (std::size_t i = 8; i-- > 0;) msg.emplace_back(index >> (8 * i));
+  return shf::Point::CreateFromHash(msg.data(), msg.size());
+}
+
+shf::CommitKey shf::CreateCommitKey(const std::size_t size,
+                                    const uint8_t* seed,
+                                    std::size_t seed_size,
+                                    shf::ThreadPool* pool) {
+  if (size == 0) throw std::invalid_argument("cannot create a key of size 0");
+
+  CommitKey ck;
+  std::vector<Point> G(size);
+  ck.H = FixedBasePoint(DeriveGenerator(seed, seed_size, 'H', 0));
+  ParallelFor(pool, size, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+      G[i] = DeriveGenerator(seed, seed_size, 'G', i);
+  });
+  ck.G = AffinePoints(std::move(G));
   return ck;
 }
 
+bool shf::SpotCheckCommitKey(const shf::CommitKey& ck, const uint8_t* seed,
+                             std::size_t seed_size, std::size_t samples,
+                             shf::ThreadPool* pool) {
+  const std::size_t n = ck.Size();
+  if (n == 0 || ck.H.Base() != DeriveGenerator(seed, seed_size, 'H', 0))
+    return false;
+
+  // positions are drawn fresh on every check, so a key cannot be made to
+  // pass by only getting the sampled generators right.
+  std::vector<uint64_t> positions(samples);
+  for (std::size_t i = 0; i < samples; i += 4) {
+    uint8_t bytes[Scalar::ByteSize()];
+    Scalar::CreateRandom().Write(bytes);
+    for (std::size_t k = i; k < std::min(i + 4, samples); ++k)
+      std::memcpy(&positions[k], bytes + 8 * (k - i), 8);
+  }
+  std::atomic<bool> valid{true};
+  ParallelFor(pool, samples, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end && valid; ++i) {
+      const std::size_t j = positions[i] % n;
+      if (ck.G[j] != DeriveGenerator(seed, seed_size, 'G', j)) valid = false;
+    }
+  });
+  return valid;
+}
+
 shf::Point shf::Commit(const shf::CommitKey& ck, const shf::Scalar& r,
-                     const std::vector<shf::Scalar>& m) {
-  const std::size_t n = m.size();
-  Point C;
-  for (std::size_t i = 0; i < n; ++i) C += m[i] * ck.G[i];
-  return C + r * ck.H;
+                     const std::vector<shf::Scalar>& m, shf::ThreadPool* pool) {
+  return MultiExp(m, ck.G, pool) + r * ck.H;
 }
 
 shf::CommitmentAndRandomness shf::Commit(const shf::CommitKey& ck,
-                                       const std::vector<shf::Scalar>& m) {
+                                       const std::vector<shf::Scalar>& m,
+                                       shf::ThreadPool* pool) {
   const auto r = Scalar::CreateRandom();
-  const auto C = Commit(ck, r, m);
+  const auto C = Commit(ck, r, m, pool);
   return {C, r};
 }
 
@@ -4,28 +4,64 @@
 #include <vector>
 
 #include "curve.h"
+#include "threadpool.h"
 
 namespace shf {
 
 struct CommitKey {
-  std::vector<Point> G;
-  Point H;
+  AffinePoints G;
+  FixedBasePoint H;
 
-  std::size_t Size() const { return G.size(); };
+  std::size_t Size() const { return G.Size(); };
 };
 
 CommitKey CreateCommitKey(const std::size_t size);
 
+/**
+ * @brief Derive a commitment key from a seed.
+ *
+ * Every generator is obtained by hashing the seed and its index to the curve,
+ * so anyone with the seed can recreate the key instead of storing it.
+ *
+ * @param size the number of generators in G
+ * @param seed the seed
+ * @param seed_size the size of the seed in bytes
+ * @param pool optional thread pool to spread the work over
+ * @return a commitment key.
+ */
+CommitKey CreateCommitKey(const std::size_t size, const uint8_t* seed,
+                          std::size_t seed_size, ThreadPool* pool = nullptr);
+
+/**
+ * @brief Spot-check that a commitment key was derived from a seed.
+ *
+ * H and a number of generators of G at random positions are derived again and
+ * compared with the key. This catches a key that was replaced as a whole,
+ * such as one with known discrete logs, at a fraction of the cost of deriving
+ * it, but not a change to a few generators that were not sampled.
+ *
+ * @param ck the key to check
+ * @param seed the seed
+ * @param seed_size the size of the seed in bytes
+ * @param samples the number of generators of G to check
+ * @param pool optional thread pool to spread the work over
+ * @return true if all checked generators match.
+ */
+bool SpotCheckCommitKey(const CommitKey& ck, const uint8_t* seed,
+                        std::size_t seed_size, std::size_t samples,
+                        ThreadPool* pool = nullptr);
+
 struct CommitmentAndRandomness {
   Point C;
   Scalar r;
 };
 
 CommitmentAndRandomness Commit(const CommitKey& ck,
-                               const std::vector<Scalar>& m);
+                               const std::vector<Scalar>& m,
+                               ThreadPool* pool = nullptr);
 
 Point Commit(const CommitKey& ck, const Scalar& r,
-             const std::vector<Scalar>& m);
+             const std::vector<Scalar>& m, ThreadPool* pool = nullptr);
 
 bool CheckCommitment(const CommitKey& ck, const Point& comm, const Scalar& r,
                      const std::vector<Scalar>& m);
@@ -1,16 +1,145 @@
 #include "curve.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-static int k_relic_initialized = 0;
+#include "threadpool.h"
+
+static std::once_flag k_relic_initialized;
 static bn_t k_curve_order;
+// the field prime, big-endian.
+static uint8_t k_prime_bytes[RLC_FP_BYTES];
+
+// The bundled relic is built without MULTI, so every thread shares a single
+// relic context. Curve arithmetic only reads from it once the curve is set
+// up, but the random generator state is updated on every draw.
+static std::mutex k_rand_mutex;
+
+// Scalars are kept in Montgomery form aR mod n with R = 2^256 and n the order
+// of the curve.
+static constexpr std::size_t kLimbs = 4;
+static uint64_t k_order[kLimbs];
+static uint64_t k_r2[kLimbs];      // R^2 mod n
+static uint64_t k_r3[kLimbs];      // R^3 mod n
+static uint64_t k_order_inv = 0;  // -n^{-1} mod 2^64
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+// r = a - b, returns the borrow.
+static inline uint64_t SubLimbs(uint64_t r[kLimbs], const uint64_t a[kLimbs],
+                                const uint64_t b[kLimbs]) {
+  uint64_t borrow = 0;
+  for (std::size_t i = 0; i < kLimbs; ++i) {
+    const uint128_t d = (uint128_t)a[i] - b[i] - borrow;
+    r[i] = (uint64_t)d;
+    borrow = (uint64_t)(d >> 64) & 1;
+  }
+  return borrow;
+}
 
-void shf::CurveInit() {
-  if (k_relic_initialized) {
-    return;
+// r = a + b, returns the carry.
+static inline uint64_t AddLimbs(uint64_t r[kLimbs], const uint64_t a[kLimbs],
+                                const uint64_t b[kLimbs]) {
+  uint64_t carry = 0;
+  for (std::size_t i = 0; i < kLimbs; ++i) {
+    const uint128_t s = (uint128_t)a[i] + b[i] + carry;
+    r[i] = (uint64_t)s;
+    carry = (uint64_t)(s >> 64);
   }
+  return carry;
+}
+
+// r = a + b mod n for a, b < n.
+static inline void AddMod(uint64_t r[kLimbs], const uint64_t a[kLimbs],
+                          const uint64_t b[kLimbs]) {
+  uint64_t s[kLimbs], d[kLimbs];
+  const uint64_t carry = AddLimbs(s, a, b);
+  const uint64_t borrow = SubLimbs(d, s, k_order);
+  std::copy(d, d + kLimbs, r);
+  if (!carry && borrow) std::copy(s, s + kLimbs, r);
+}
+
+// r = a - b mod n for a, b < n.
+static inline void SubMod(uint64_t r[kLimbs], const uint64_t a[kLimbs],
+                          const uint64_t b[kLimbs]) {
+  uint64_t d[kLimbs];
+  if (SubLimbs(d, a, b))
+    AddLimbs(r, d, k_order);
+  else
+    std::copy(d, d + kLimbs, r);
+}
+
+// r = a * b * R^{-1} mod n for a < R and b < n (CIOS).
+static inline void MontMul(uint64_t r[kLimbs], const uint64_t a[kLimbs],
+                           const uint64_t b[kLimbs]) {
+  uint64_t t[kLimbs + 2] = {0};
+  for (std::size_t i = 0; i < kLimbs; ++i) {
+    uint64_t c = 0;
+    for (std::size_t j = 0; j < kLimbs; ++j) {
+      const uint128_t s = (uint128_t)a[j] * b[i] + t[j] + c;
+      t[j] = (uint64_t)s;
+      c = (uint64_t)(s >> 64);
+    }
+    uint128_t s = (uint128_t)t[kLimbs] + c;
+    t[kLimbs] = (uint64_t)s;
+    t[kLimbs + 1] = (uint64_t)(s >> 64);
+
+    const uint64_t m = t[0] * k_order_inv;
+    s = (uint128_t)m * k_order[0] + t[0];
+    c = (uint64_t)(s >> 64);
+    for (std::size_t j = 1; j < kLimbs; ++j) {
+      s = (uint128_t)m * k_order[j] + t[j] + c;
+      t[j - 1] = (uint64_t)s;
+      c = (uint64_t)(s >> 64);
+    }
+    s = (uint128_t)t[kLimbs] + c;
+    t[kLimbs - 1] = (uint64_t)s;
+    t[kLimbs] = t[kLimbs + 1] + (uint64_t)(s >> 64);
+  }
+
+  // t < 2n at this point.
+  uint64_t d[kLimbs];
+  const uint64_t borrow = SubLimbs(d, t, k_order);
+  if (t[kLimbs] || !borrow)
+    std::copy(d, d + kLimbs, r);
+  else
+    std::copy(t, t + kLimbs, r);
+}
+
+static inline void FromMont(uint64_t r[kLimbs], const uint64_t a[kLimbs]) {
+  const uint64_t one[kLimbs] = {1, 0, 0, 0};
+  MontMul(r, a, one);
+}
+
+static void InitScalarField() {
+  if (bn_bits(k_curve_order) > (int)(64 * kLimbs))
+    throw std::runtime_error("curve order does not fit in a Scalar");
+
+  bn_write_raw(k_order, kLimbs, k_curve_order);
+
+  bn_t r2;
+  bn_new(r2);
+  bn_set_2b(r2, 2 * 64 * kLimbs);
+  bn_mod(r2, r2, k_curve_order);
+  bn_write_raw(k_r2, kLimbs, r2);
+  bn_set_2b(r2, 3 * 64 * kLimbs);
+  bn_mod(r2, r2, k_curve_order);
+  bn_write_raw(k_r3, kLimbs, r2);
+  bn_free(r2);
 
+  // Newton iteration for n^{-1} mod 2^64. Each step doubles the number of
+  // correct bits.
+  uint64_t inv = 1;
+  for (std::size_t i = 0; i < 6; ++i) inv *= 2 - k_order[0] * inv;
+  k_order_inv = -inv;
+}
+
+static void InitRelic() {
   core_init();
   if (err_get_code() != RLC_OK) {
     throw std::runtime_error("relic core_init() failed");
@@ -24,57 +153,208 @@ void shf::CurveInit() {
 
   bn_new(k_curve_order);
   ec_curve_get_ord(k_curve_order);
+  InitScalarField();
+
+  bn_t prime;
+  bn_new(prime);
+  bn_read_raw(prime, fp_prime_get(), RLC_FP_DIGS);
+  bn_write_bin(k_prime_bytes, RLC_FP_BYTES, prime);
+  bn_free(prime);
+}
+
+void shf::CurveInit() { std::call_once(k_relic_initialized, InitRelic); }
 
-  k_relic_initialized = 1;
+#ifdef SHF_TESTING
+void shf::CurveSeedRandom(const uint8_t* seed, std::size_t size) {
+  std::vector<uint8_t> buf(seed, seed + size);
+  std::lock_guard<std::mutex> lock(k_rand_mutex);
+  // reseeding a seeded generator mixes in its current state.
+  core_get()->seeded = 0;
+  rand_seed(buf.data(), buf.size());
 }
 
+void shf::CurveReseedRandom() {
+  std::lock_guard<std::mutex> lock(k_rand_mutex);
+  // rand_init draws a fresh seed from the system source, as core_init does.
+  core_get()->seeded = 0;
+  rand_init();
+}
+#endif
+
 shf::Point shf::Point::Generator() {
   Point g;
   ec_curve_get_gen(g.m_internal);
   return g;
 }
 
+shf::Point shf::Point::MulGenerator(const shf::Scalar& scalar) {
+  Point r;
+  bn_t k;
+  bn_new(k);
+  scalar.ToBn(k);
+  ec_mul_gen(r.m_internal, k);
+  bn_free(k);
+  return r;
+}
+
+shf::Point shf::Point::MulSim(const shf::Scalar& a, const shf::Point& P,
+                             const shf::Scalar& b, const shf::Point& Q) {
+  Point r;
+  bn_t k, l;
+  bn_new(k);
+  bn_new(l);
+  a.ToBn(k);
+  b.ToBn(l);
+  ec_mul_sim(r.m_internal, P.m_internal, k, Q.m_internal, l);
+  bn_free(k);
+  bn_free(l);
+  return r;
+}
+
 shf::Point shf::Point::CreateRandom() {
   Point p;
+  std::lock_guard<std::mutex> lock(k_rand_mutex);
   ec_rand(p.m_internal);
   return p;
 }
 
-shf::Point shf::Point::Read(const uint8_t* bytes) {
+shf::Point shf::Point::CreateFromHash(const uint8_t* msg, std::size_t n) {
   Point p;
-  if (!bytes[0]) ec_read_bin(p.m_internal, bytes + 1, ByteSize() - 1);
+  ec_map(p.m_internal, msg, n);
   return p;
 }
 
-shf::Point::Point() {
-  ec_new(m_internal);
-  ec_set_infty(m_internal);
+// reads a coordinate. relic reduces it modulo the field prime, so one that is
+// too large is rejected to give every point exactly one encoding.
+static inline bool ReadCoordinate(fp_t a, const uint8_t* bytes) {
+  if (std::memcmp(bytes, k_prime_bytes, RLC_FP_BYTES) >= 0) return false;
+  fp_read_bin(a, bytes, RLC_FP_BYTES);
+  return true;
 }
 
-shf::Point::~Point() { ec_free(m_internal); }
+// decodes a point written by Point::Write, and only that encoding. This does
+// what ec_read_bin does, but reports an invalid point by its return value:
+// relic reports it in its error state, which every thread shares in this
+// build, so decoding from several threads would race on it.
+static inline bool DecodePoint(ec_t p, const uint8_t* bytes, std::size_t len) {
+  if (bytes[0] == 1) {
+    ec_set_infty(p);
+    return std::all_of(bytes + 1, bytes + len, [](uint8_t b) { return !b; });
+  }
+  if (bytes[0] != 0) return false;
+
+  const bool compressed = len == shf::Point::ByteSize();
+  const uint8_t tag = bytes[1];
+  if (compressed ? tag != 2 && tag != 3 : tag != 4) return false;
+
+  if (!ReadCoordinate(p->x, bytes + 2)) return false;
+  fp_set_dig(p->z, 1);
+  p->norm = 1;
+  if (compressed) {
+    // the tag gives the parity of y, which ec_upk takes from p->y.
+    if (tag == 2)
+      fp_zero(p->y);
+    else
+      fp_set_dig(p->y, 1);
+    return ec_upk(p, p) == 1;
+  }
+  return ReadCoordinate(p->y, bytes + 2 + RLC_FP_BYTES) && ec_is_valid(p);
+}
 
-shf::Point::Point(const shf::Point& other) {
-  ec_new(m_internal);
-  ec_copy(m_internal, other.m_internal);
+shf::Point shf::Point::Read(const uint8_t* bytes, Encoding encoding) {
+  Point p;
+  if (!DecodePoint(p.m_internal, bytes, ByteSize(encoding)))
+    throw std::invalid_argument("invalid point encoding");
+  return p;
 }
 
-shf::Point::Point(shf::Point&& other) {
-  ec_new(m_internal);
-  ec_copy(m_internal, other.m_internal);
+std::vector<std::size_t> shf::Point::ReadBatch(const uint8_t* bytes,
+                                               std::size_t n, Point* out,
+                                               Encoding encoding,
+                                               ThreadPool* pool) {
+  const std::size_t len = ByteSize(encoding);
+  std::vector<char> invalid(n);
+  ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      if (!DecodePoint(out[i].m_internal, bytes + i * len, len)) {
+        ec_set_infty(out[i].m_internal);
+        invalid[i] = 1;
+      }
+    }
+  });
+
+  std::vector<std::size_t> errors;
+  for (std::size_t i = 0; i < n; ++i)
+    if (invalid[i]) errors.emplace_back(i);
+  return errors;
 }
 
-shf::Point& shf::Point::operator=(const shf::Point& other) {
-  ec_copy(m_internal, other.m_internal);
-  return *this;
+shf::Point::Point() {
+  ec_new(m_internal);
+  ec_set_infty(m_internal);
 }
 
-shf::Point& shf::Point::operator=(shf::Point&& other) {
-  ec_copy(m_internal, other.m_internal);
-  return *this;
+void shf::Point::Swap(shf::Point& other) noexcept {
+  std::swap(m_internal[0], other.m_internal[0]);
 }
 
 bool shf::Point::IsInfinity() const { return ec_is_infty(m_internal) == 1; }
 
+bool shf::Point::IsNormalized() const {
+  return IsInfinity() || m_internal->norm;
+}
+
+// ep_norm_sim keeps its inverses on the stack, so batches are bounded.
+static constexpr std::size_t kNormalizeBatchSize = 1024;
+
+void shf::Point::NormalizeBatch(const std::vector<shf::Point*>& points) {
+  std::vector<Point*> todo;
+  for (Point* p : points)
+    if (!p->IsNormalized()) todo.emplace_back(p);
+
+  std::vector<Point> batch;
+  batch.reserve(std::min(kNormalizeBatchSize, todo.size()));
+  for (std::size_t i = 0; i < todo.size(); i += kNormalizeBatchSize) {
+    const std::size_t m = std::min(kNormalizeBatchSize, todo.size() - i);
+    batch.clear();
+    for (std::size_t j = 0; j < m; ++j) batch.emplace_back(*todo[i + j]);
+    ec_t* t = reinterpret_cast<ec_t*>(batch.data());
+    ep_norm_sim(t, t, m);
+    for (std::size_t j = 0; j < m; ++j) *todo[i + j] = batch[j];
+  }
+}
+
+// points written by WriteBatch are normalized this many at a time, in a
+// buffer on the stack.
+static constexpr std::size_t kWriteBatchSize = 128;
+
+void shf::Point::WriteBatch(const shf::Point* const* points, std::size_t n,
+                            uint8_t* dest) {
+  ec_t batch[kWriteBatchSize];
+  std::size_t index[kWriteBatchSize];
+  for (std::size_t i = 0; i < n; i += kWriteBatchSize) {
+    const std::size_t m = std::min(kWriteBatchSize, n - i);
+    std::size_t todo = 0;
+    for (std::size_t j = 0; j < m; ++j) {
+      if (points[i + j]->IsNormalized()) continue;
+      ec_copy(batch[todo], points[i + j]->m_internal);
+      index[todo++] = j;
+    }
+    if (todo) ep_norm_sim(batch, batch, todo);
+
+    std::size_t k = 0;
+    for (std::size_t j = 0; j < m; ++j) {
+      uint8_t* out = dest + (i + j) * ByteSize();
+      if (k < todo && index[k] == j) {
+        out[0] = 0;
+        ec_write_bin(out + 1, ByteSize() - 1, batch[k++], 1);
+      } else {
+        points[i + j]->Write(out);
+      }
+    }
+  }
+}
+
 shf::Point shf::Point::operator+(const shf::Point& other) const {
   Point r;
   ec_add(r.m_internal, m_internal, other.m_internal);
@@ -99,7 +379,11 @@ shf::Point& shf::Point::operator-=(const shf::Point& other) {
 
 shf::Point shf::Point::operator*(const shf::Scalar& scalar) const {
   Point r;
-  ec_mul(r.m_internal, m_internal, scalar.m_internal);
+  bn_t k;
+  bn_new(k);
+  scalar.ToBn(k);
+  ec_mul(r.m_internal, m_internal, k);
+  bn_free(k);
   return r;
 }
 
@@ -107,105 +391,235 @@ bool shf::Point::operator==(const shf::Point& other) const {
   return ec_cmp(m_internal, other.m_internal) == RLC_EQ;
 }
 
-void shf::Point::Write(uint8_t* dest) const {
-  if (IsInfinity())
-    dest[0] = 1;
-  else {
-    dest[0] = 0;
-    ec_write_bin(dest + 1, ByteSize() - 1, m_internal, 1);
-  }
+void shf::Point::WriteRaw(uint8_t* dest) const {
+  ec_t tmp;
+  std::memset(tmp, 0, sizeof(tmp));
+  ec_copy(tmp, m_internal);
+  std::memcpy(dest, tmp, sizeof(tmp));
 }
 
-shf::Scalar::Scalar() {
-  bn_new(m_internal);
-  bn_zero(m_internal);
+// whether a coordinate in relic's representation is below the prime.
+static inline bool IsReduced(const fp_t a) {
+  return dv_cmp(a, fp_prime_get(), RLC_FP_DIGS) == RLC_LT;
 }
 
-shf::Scalar::~Scalar() { bn_free(m_internal); }
+bool shf::Point::IsValidRaw() const {
+  const auto& p = m_internal;
+  if (p->norm != 1 || !IsReduced(p->x) || !IsReduced(p->y) ||
+      !IsReduced(p->z))
+    return false;
+  if (fp_is_zero(p->z)) return fp_is_zero(p->x) && fp_is_zero(p->y);
+  return fp_cmp_dig(p->z, 1) == RLC_EQ && ec_is_valid(p);
+}
 
-shf::Scalar::Scalar(const shf::Scalar& other) {
-  bn_new(m_internal);
-  bn_copy(m_internal, other.m_internal);
+void shf::Point::Write(uint8_t* dest, Encoding encoding) const {
+  const std::size_t len = ByteSize(encoding);
+  if (IsInfinity()) {
+    // the padding makes the encoding unique, so it can be hashed as is.
+    dest[0] = 1;
+    std::memset(dest + 1, 0, len - 1);
+  } else {
+    dest[0] = 0;
+    ec_write_bin(dest + 1, len - 1, m_internal,
+                 encoding == Encoding::kCompressed);
+  }
 }
 
-shf::Scalar::Scalar(shf::Scalar&& other) {
-  bn_new(m_internal);
-  bn_copy(m_internal, other.m_internal);
+// the precomputation functions of relic operate on arrays of ec_t.
+static_assert(sizeof(shf::Point) == sizeof(ec_t),
+              "Point must have the same layout as ec_t");
+
+#if ALLOC != AUTO
+#error "Point and Scalar assume that relic stores its types inline"
+#endif
+
+static_assert(std::is_trivially_copyable<shf::Point>::value &&
+                  std::is_trivially_copyable<shf::Scalar>::value,
+              "Point and Scalar must be cheap to copy and move");
+static_assert(sizeof(shf::Scalar) == shf::Scalar::ByteSize(),
+              "Scalar must not carry more than its limbs");
+
+shf::AffinePoints::AffinePoints(std::vector<shf::Point> points) {
+  auto owned = std::make_shared<std::vector<Point>>(std::move(points));
+  std::vector<Point*> ptrs;
+  ptrs.reserve(owned->size());
+  for (auto& p : *owned) ptrs.emplace_back(&p);
+  Point::NormalizeBatch(ptrs);
+  m_data = owned->data();
+  m_size = owned->size();
+  m_owner = std::move(owned);
+}
+
+shf::AffinePoints shf::AffinePoints::View(std::shared_ptr<const void> owner,
+                                          const shf::Point* points,
+                                          std::size_t n) {
+  AffinePoints view;
+  view.m_owner = std::move(owner);
+  view.m_data = points;
+  view.m_size = n;
+  return view;
+}
+
+shf::FixedBasePoint::FixedBasePoint(const shf::Point& base)
+    : m_base(base) {
+  auto table = std::make_shared<std::vector<Point>>(TableSize());
+  ec_mul_pre(reinterpret_cast<ec_t*>(table->data()), m_base.m_internal);
+  m_table = table->data();
+  m_owner = std::move(table);
+}
+
+shf::FixedBasePoint shf::FixedBasePoint::View(const shf::Point& base,
+                                              std::shared_ptr<const void> owner,
+                                              const shf::Point* table) {
+  FixedBasePoint p;
+  p.m_base = base;
+  p.m_owner = std::move(owner);
+  p.m_table = table;
+  return p;
 }
 
-shf::Scalar& shf::Scalar::operator=(const shf::Scalar& other) {
-  bn_copy(m_internal, other.m_internal);
-  return *this;
+shf::Point shf::FixedBasePoint::operator*(const shf::Scalar& scalar) const {
+  if (!m_table) return m_base * scalar;
+  Point r;
+  bn_t k;
+  bn_new(k);
+  scalar.ToBn(k);
+  ec_mul_fix(r.m_internal, reinterpret_cast<const ec_t*>(m_table), k);
+  bn_free(k);
+  return r;
 }
 
-shf::Scalar& shf::Scalar::operator=(shf::Scalar&& other) {
-  bn_copy(m_internal, other.m_internal);
-  return *this;
+shf::Scalar::Scalar() : m_limbs{0} {}
+
+void shf::Scalar::Swap(shf::Scalar& other) noexcept {
+  std::swap(m_limbs, other.m_limbs);
 }
 
-bool shf::Scalar::IsZero() const { return bn_is_zero(m_internal) == 1; }
+bool shf::Scalar::IsZero() const {
+  return (m_limbs[0] | m_limbs[1] | m_limbs[2] | m_limbs[3]) == 0;
+}
 
 shf::Scalar shf::Scalar::operator+(const shf::Scalar& other) const {
   Scalar r;
-  bn_add(r.m_internal, m_internal, other.m_internal);
-  bn_mod(r.m_internal, r.m_internal, k_curve_order);
+  AddMod(r.m_limbs, m_limbs, other.m_limbs);
   return r;
 }
 
 shf::Scalar shf::Scalar::operator-(const shf::Scalar& other) const {
   Scalar r;
-  bn_sub(r.m_internal, m_internal, other.m_internal);
-  bn_mod(r.m_internal, r.m_internal, k_curve_order);
+  SubMod(r.m_limbs, m_limbs, other.m_limbs);
   return r;
 }
 
 shf::Scalar shf::Scalar::operator*(const shf::Scalar& other) const {
   Scalar r;
-  bn_mul(r.m_internal, m_internal, other.m_internal);
-  bn_mod(r.m_internal, r.m_internal, k_curve_order);
+  MontMul(r.m_limbs, m_limbs, other.m_limbs);
   return r;
 }
 
 shf::Scalar shf::Scalar::operator-() const {
   Scalar r;
-  bn_sub(r.m_internal, k_curve_order, m_internal);
+  SubMod(r.m_limbs, r.m_limbs, m_limbs);
   return r;
 }
 
 shf::Scalar& shf::Scalar::operator+=(const shf::Scalar& other) {
-  bn_add(m_internal, m_internal, other.m_internal);
-  bn_mod(m_internal, m_internal, k_curve_order);
+  AddMod(m_limbs, m_limbs, other.m_limbs);
+  return *this;
+}
+
+shf::Scalar& shf::Scalar::operator-=(const shf::Scalar& other) {
+  SubMod(m_limbs, m_limbs, other.m_limbs);
   return *this;
 }
 
 shf::Scalar& shf::Scalar::operator*=(const shf::Scalar& other) {
-  bn_mul(m_internal, m_internal, other.m_internal);
-  bn_mod(m_internal, m_internal, k_curve_order);
+  MontMul(m_limbs, m_limbs, other.m_limbs);
   return *this;
 }
 
 bool shf::Scalar::operator==(const shf::Scalar& other) const {
-  return bn_cmp(m_internal, other.m_internal) == RLC_EQ;
+  return std::equal(m_limbs, m_limbs + kLimbs, other.m_limbs);
 }
 
 void shf::Scalar::Write(uint8_t* dest) const {
-  bn_write_bin(dest, ByteSize(), m_internal);
+  uint64_t v[kLimbs];
+  FromMont(v, m_limbs);
+  for (std::size_t i = 0; i < ByteSize(); ++i)
+    dest[ByteSize() - 1 - i] = (uint8_t)(v[i / 8] >> (8 * (i % 8)));
+}
+
+void shf::Scalar::Print() const {
+  bn_t b;
+  bn_new(b);
+  ToBn(b);
+  bn_print(b);
+  bn_free(b);
+}
+
+void shf::Scalar::ToBn(bn_t dest) const {
+  uint64_t v[kLimbs];
+  FromMont(v, m_limbs);
+  bn_read_raw(dest, v, kLimbs);
 }
 
 shf::Scalar shf::Scalar::CreateRandom() {
+  bn_t b;
+  bn_new(b);
+  {
+    std::lock_guard<std::mutex> lock(k_rand_mutex);
+    bn_rand_mod(b, k_curve_order);
+  }
+  uint64_t v[kLimbs];
+  bn_write_raw(v, kLimbs, b);
+  bn_free(b);
   Scalar s;
-  bn_rand_mod(s.m_internal, k_curve_order);
+  MontMul(s.m_limbs, v, k_r2);
   return s;
 }
 
 shf::Scalar shf::Scalar::CreateFromInt(unsigned int v) {
+  const uint64_t raw[kLimbs] = {v, 0, 0, 0};
   Scalar s;
-  bn_set_dig(s.m_internal, (dig_t)v);
+  MontMul(s.m_limbs, raw, k_r2);
   return s;
 }
 
+// reads a 256-bit big-endian integer into limbs.
+static inline void ReadLimbs(uint64_t raw[kLimbs], const uint8_t* bytes) {
+  const std::size_t size = shf::Scalar::ByteSize();
+  std::fill(raw, raw + kLimbs, 0);
+  for (std::size_t i = 0; i < size; ++i)
+    raw[i / 8] |= (uint64_t)bytes[size - 1 - i] << (8 * (i % 8));
+}
+
 shf::Scalar shf::Scalar::Read(const uint8_t* bytes) {
+  uint64_t raw[kLimbs];
+  ReadLimbs(raw, bytes);
+  // any 256-bit value times R^2 is small enough for a Montgomery reduction,
+  // so this also reduces values that are not smaller than the order.
+  Scalar s;
+  MontMul(s.m_limbs, raw, k_r2);
+  return s;
+}
+
+shf::Scalar shf::Scalar::ReadCanonical(const uint8_t* bytes) {
+  uint64_t raw[kLimbs];
+  ReadLimbs(raw, bytes);
+  uint64_t d[kLimbs];
+  if (!SubLimbs(d, raw, k_order))
+    throw std::invalid_argument("scalar not smaller than the group order");
   Scalar s;
-  bn_read_bin(s.m_internal, bytes, ByteSize());
+  MontMul(s.m_limbs, raw, k_r2);
   return s;
 }
+
+shf::Scalar shf::Scalar::ReadWide(const uint8_t* bytes) {
+  // hi*2^256 + lo in Montgomery form is hi*R^3*R^-1 + lo*R^2*R^-1.
+  const Scalar lo = Read(bytes + ByteSize());
+  uint64_t hi[kLimbs];
+  ReadLimbs(hi, bytes);
+  Scalar s;
+  MontMul(s.m_limbs, hi, k_r3);
+  return s + lo;
+}
@@ -4,6 +4,8 @@
 #include <gmp.h>
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 extern "C" {
 #include "include/relic/relic.h"
@@ -13,30 +15,86 @@ namespace shf {
 
 /**
  * @brief Initializes relic. Must be called before anything else.
+ *
+ * Can be called from any number of threads; relic is only set up once. When
+ * it returns, Points and Scalars can be used concurrently from all threads.
+ * Draws from the random generator are serialized internally.
  */
 void CurveInit();
 
+#ifdef SHF_TESTING
+/**
+ * @brief Put the random generator used for Points and Scalars in a fixed
+ * state.
+ *
+ * Only built with SHF_TESTING, for reproducible tests. The same seed always
+ * gives the same sequence of random Points and Scalars, so every test that
+ * calls this must call CurveReseedRandom when it is done.
+ *
+ * @param seed the seed
+ * @param size the size of the seed in bytes
+ */
+void CurveSeedRandom(const uint8_t* seed, std::size_t size);
+
+/**
+ * @brief Reseed the random generator used for Points and Scalars from the
+ * system source, undoing CurveSeedRandom. Only built with SHF_TESTING.
+ */
+void CurveReseedRandom();
+#endif
+
 class Point;
+class FixedBasePoint;
+class ThreadPool;
 
 class Scalar {
  public:
   // internal access needed for scalar multiplications.
   friend class Point;
+  friend class FixedBasePoint;
 
   static Scalar CreateRandom();
   static Scalar CreateFromInt(unsigned int v);
   static Scalar Read(const uint8_t* bytes);
 
+  /**
+   * @brief Decode a scalar written by Write, and only that encoding.
+   *
+   * Read reduces any 256-bit value, so s and s + n decode to the same
+   * scalar. This rejects values that are not smaller than the group order,
+   * so that every scalar has exactly one encoding.
+   *
+   * @param bytes ByteSize() bytes
+   * @return the scalar.
+   * @throws std::invalid_argument if the value is not smaller than the
+   * order.
+   */
+  static Scalar ReadCanonical(const uint8_t* bytes);
+
+  /**
+   * @brief Reduce a 512-bit big-endian integer modulo the group order.
+   *
+   * Turns 64 uniformly random bytes, such as hash output, into a scalar with
+   * a negligible bias.
+   *
+   * @param bytes WideByteSize() bytes
+   */
+  static Scalar ReadWide(const uint8_t* bytes);
+
   static constexpr std::size_t ByteSize() { return 32; };
+  static constexpr std::size_t WideByteSize() { return 2 * ByteSize(); };
 
   Scalar();
-  ~Scalar();
 
-  Scalar(const Scalar& other);
-  Scalar(Scalar&& other);
+  // a scalar is a plain array of limbs, so copies and moves are memcpys.
+  Scalar(const Scalar& other) = default;
+  Scalar(Scalar&& other) noexcept = default;
+
+  Scalar& operator=(const Scalar& other) = default;
+  Scalar& operator=(Scalar&& other) noexcept = default;
 
-  Scalar& operator=(const Scalar& other);
-  Scalar& operator=(Scalar&& other);
+  void Swap(Scalar& other) noexcept;
+  friend void swap(Scalar& a, Scalar& b) noexcept { a.Swap(b); };
 
   bool IsZero() const;
 
@@ -55,30 +113,131 @@ class Scalar {
 
   void Write(uint8_t* dest) const;
 
-  void Print() const { bn_print(m_internal); }
+  void Print() const;
 
  private:
-  bn_t m_internal;
+  static constexpr std::size_t kLimbs = 4;
+
+  // converts to a relic integer for the scalar multiplication functions.
+  void ToBn(bn_t dest) const;
+
+  // little-endian limbs in Montgomery form.
+  uint64_t m_limbs[kLimbs];
 };
 
 class Point {
  public:
+  friend class FixedBasePoint;
+
+  // internal access needed for multi-scalar multiplications.
+  friend Point MultiExp(const std::vector<Scalar>& scalars,
+                        const std::vector<const Point*>& points,
+                        ThreadPool* pool);
+
   static Point Generator();
+  static Point MulGenerator(const Scalar& scalar);
+
+  /**
+   * @brief Compute a*P + b*Q with interleaved multiplications.
+   *
+   * Shares the doublings between both terms, which makes it cheaper than two
+   * separate multiplications and an addition.
+   */
+  static Point MulSim(const Scalar& a, const Point& P, const Scalar& b,
+                      const Point& Q);
   static Point CreateRandom();
-  static Point Read(const uint8_t* bytes);
 
-  static std::size_t ByteSize() { return 2 + RLC_FP_BYTES; };
+  /**
+   * @brief Hash a message to a point with an unknown discrete log.
+   * @param msg the message
+   * @param n the length of the message
+   * @return a point that only depends on the message.
+   */
+  static Point CreateFromHash(const uint8_t* msg, std::size_t n);
+
+  /**
+   * @brief Encodings of a point.
+   *
+   * A compressed point holds the x coordinate and the sign of y, and takes a
+   * square root to decode. An uncompressed point holds both coordinates,
+   * which makes it about twice as large but cheap to decode.
+   */
+  enum class Encoding { kCompressed, kUncompressed };
+
+  /**
+   * @brief Decode a point.
+   * @param bytes ByteSize(encoding) bytes written by Write
+   * @param encoding the encoding of the point
+   * @return the point.
+   * @throws std::invalid_argument if the bytes do not encode a point on the
+   * curve.
+   */
+  static Point Read(const uint8_t* bytes,
+                    Encoding encoding = Encoding::kCompressed);
+
+  /**
+   * @brief Decode many points and check that they are on the curve.
+   * @param bytes n points of ByteSize(encoding) bytes each
+   * @param n the number of points
+   * @param out where to store the n points
+   * @param encoding the encoding of the points
+   * @param pool optional thread pool to decode on
+   * @return the indices of the points that could not be decoded, in
+   * increasing order. These points are set to the point at infinity.
+   */
+  static std::vector<std::size_t> ReadBatch(
+      const uint8_t* bytes, std::size_t n, Point* out,
+      Encoding encoding = Encoding::kCompressed, ThreadPool* pool = nullptr);
+
+  static constexpr std::size_t ByteSize() { return 2 + RLC_FP_BYTES; };
+
+  /**
+   * @brief Size of an encoded point.
+   * @param encoding the encoding
+   */
+  static constexpr std::size_t ByteSize(Encoding encoding) {
+    return encoding == Encoding::kCompressed ? ByteSize()
+                                             : 2 + 2 * RLC_FP_BYTES;
+  };
+
+  /**
+   * @brief Bring a list of points to affine coordinates.
+   *
+   * All points share a single field inversion (Montgomery's trick), which is
+   * otherwise paid per point when it is written or used in a mixed addition.
+   *
+   * @param points the points to normalize
+   */
+  static void NormalizeBatch(const std::vector<Point*>& points);
+
+  /**
+   * @brief Encode a list of points.
+   *
+   * Points that are not in affine coordinates share a field inversion, and
+   * nothing is allocated on the heap.
+   *
+   * @param points pointers to the points
+   * @param n the number of points
+   * @param dest where to write n*ByteSize() bytes
+   */
+  static void WriteBatch(const Point* const* points, std::size_t n,
+                         uint8_t* dest);
 
   Point();
-  ~Point();
 
-  Point(const Point& other);
-  Point(Point&& other);
+  // relic is built with ALLOC == AUTO, so the coordinates are stored inline
+  // and copies and moves are memcpys of the underlying struct.
+  Point(const Point& other) = default;
+  Point(Point&& other) noexcept = default;
+
+  Point& operator=(const Point& other) = default;
+  Point& operator=(Point&& other) noexcept = default;
 
-  Point& operator=(const Point& other);
-  Point& operator=(Point&& other);
+  void Swap(Point& other) noexcept;
+  friend void swap(Point& a, Point& b) noexcept { a.Swap(b); };
 
   bool IsInfinity() const;
+  bool IsNormalized() const;
 
   Point operator+(const Point& other) const;
   Point operator-(const Point& other) const;
@@ -94,7 +253,42 @@ class Point {
   bool operator==(const Point& other) const;
   bool operator!=(const Point& other) const { return !(*this == other); }
 
-  void Write(uint8_t* dest) const;
+  /**
+   * @brief Encode the point.
+   * @param dest where to write ByteSize(encoding) bytes
+   * @param encoding the encoding to use
+   */
+  void Write(uint8_t* dest, Encoding encoding = Encoding::kCompressed) const;
+
+  /**
+   * @brief Size of the in-memory representation of a point.
+   */
+  static constexpr std::size_t RawSize() { return sizeof(ec_t); };
+
+  /**
+   * @brief Write the in-memory representation of the point.
+   *
+   * Padding is cleared, so equal points in the same coordinates give equal
+   * bytes. The bytes are only meaningful to programs built against the same
+   * relic configuration; they are meant for files that are memory mapped and
+   * used in place.
+   *
+   * @param dest where to write RawSize() bytes
+   */
+  void WriteRaw(uint8_t* dest) const;
+
+  /**
+   * @brief Check a point that is used in place from bytes written by
+   * WriteRaw.
+   *
+   * Such bytes may come from anywhere, so this accepts only what WriteRaw
+   * writes for a normalized point: the point at infinity, or a point in
+   * affine coordinates (z = 1 and marked as normalized) whose coordinates
+   * are reduced and which is on the curve.
+   *
+   * @return true if the point can be used as is.
+   */
+  bool IsValidRaw() const;
 
   void Print() const { ec_print(m_internal); }
 
@@ -102,5 +296,93 @@ class Point {
   ec_t m_internal;
 };
 
+/**
+ * @brief A list of points kept in affine coordinates.
+ *
+ * Additions into affine points are cheaper mixed additions, and writing them
+ * does not need a field inversion.
+ *
+ * The points are immutable, so copies share the same storage. The storage is
+ * either owned or a view into memory kept alive by someone else, such as a
+ * memory mapped file.
+ */
+class AffinePoints {
+ public:
+  AffinePoints(){};
+  explicit AffinePoints(std::vector<Point> points);
+
+  /**
+   * @brief Create a view over points that are already affine.
+   * @param owner keeps the memory of the points alive
+   * @param points the points
+   * @param n the number of points
+   * @return a list of points that does not copy the input.
+   */
+  static AffinePoints View(std::shared_ptr<const void> owner,
+                           const Point* points, std::size_t n);
+
+  std::size_t Size() const { return m_size; };
+
+  const Point& operator[](std::size_t i) const { return m_data[i]; };
+
+  using const_iterator = const Point*;
+
+  const_iterator begin() const { return m_data; };
+  const_iterator end() const { return m_data + m_size; };
+
+ private:
+  std::shared_ptr<const void> m_owner;
+  const Point* m_data = nullptr;
+  std::size_t m_size = 0;
+};
+
+/**
+ * @brief A point with a precomputed table for fixed-base multiplication.
+ *
+ * Building the table costs about as much as a few multiplications, so this is
+ * meant for points that are multiplied many times, such as a public key or
+ * the blinding base of a commitment key.
+ */
+class FixedBasePoint {
+ public:
+  FixedBasePoint(){};
+  explicit FixedBasePoint(const Point& base);
+
+  /**
+   * @brief Create a fixed base point from a table computed earlier.
+   * @param base the base
+   * @param owner keeps the memory of the table alive
+   * @param table TableSize() points, as returned by Table() for the same base
+   * @return a fixed base point that does not copy the table.
+   */
+  static FixedBasePoint View(const Point& base,
+                             std::shared_ptr<const void> owner,
+                             const Point* table);
+
+  /**
+   * @brief Number of points in a precomputed table.
+   */
+  static constexpr std::size_t TableSize() { return RLC_EC_TABLE; };
+
+  const Point& Base() const { return m_base; };
+
+  /**
+   * @brief The precomputed table, or null for a default constructed object.
+   */
+  const Point* Table() const { return m_table; };
+
+  Point operator*(const Scalar& scalar) const;
+  friend Point operator*(const Scalar& scalar, const FixedBasePoint& point) {
+    return point * scalar;
+  };
+
+ private:
+  Point m_base;
+  // the table is immutable, so copies share it. Null for a default
+  // constructed object.
+  std::shared_ptr<const void> m_owner;
+  const Point* m_table = nullptr;
+};
+
 }  // namespace mh
 #endif  // SHF_CURVE_H
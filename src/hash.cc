@@ -1,8 +1,17 @@
 #include "hash.h"
 
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+#define SHF_SHA_NI 1
+#endif
+
 static const uint64_t keccakf_rndc[24] = {
     0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
     0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
@@ -13,51 +22,731 @@ static const uint64_t keccakf_rndc[24] = {
     0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
     0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
 
-static const unsigned int keccakf_rotc[24] = {1,  3,  6,  10, 15, 21, 28, 36,
-                                              45, 55, 2,  14, 27, 41, 56, 8,
-                                              25, 43, 62, 18, 39, 61, 20, 44};
+template <typename Lane>
+static inline Lane Rotl64(Lane x, unsigned int y) {
+  return (x << y) | (x >> (64 - y));
+}
+
+// chi on the lanes b<x><y> into a<x><y>. Without an and-not instruction, the
+// lanes a10, a20, a31, a22, a23 and a04 are kept complemented between rounds
+// (the lane complementing transform of the Keccak team), which turns all but
+// one NOT per plane into an OR. x86-64 has andn with BMI1, and there the plain
+// form is faster.
+#if defined(__BMI__)
+#define KECCAK_COMPLEMENT() \
+  do {                      \
+  } while (0)
+#define KECCAK_CHI()                                                           \
+  do {                                                                         \
+    a00 = b00 ^ (~b10 & b20);                                                  \
+    a10 = b10 ^ (~b20 & b30);                                                  \
+    a20 = b20 ^ (~b30 & b40);                                                  \
+    a30 = b30 ^ (~b40 & b00);                                                  \
+    a40 = b40 ^ (~b00 & b10);                                                  \
+    a01 = b01 ^ (~b11 & b21);                                                  \
+    a11 = b11 ^ (~b21 & b31);                                                  \
+    a21 = b21 ^ (~b31 & b41);                                                  \
+    a31 = b31 ^ (~b41 & b01);                                                  \
+    a41 = b41 ^ (~b01 & b11);                                                  \
+    a02 = b02 ^ (~b12 & b22);                                                  \
+    a12 = b12 ^ (~b22 & b32);                                                  \
+    a22 = b22 ^ (~b32 & b42);                                                  \
+    a32 = b32 ^ (~b42 & b02);                                                  \
+    a42 = b42 ^ (~b02 & b12);                                                  \
+    a03 = b03 ^ (~b13 & b23);                                                  \
+    a13 = b13 ^ (~b23 & b33);                                                  \
+    a23 = b23 ^ (~b33 & b43);                                                  \
+    a33 = b33 ^ (~b43 & b03);                                                  \
+    a43 = b43 ^ (~b03 & b13);                                                  \
+    a04 = b04 ^ (~b14 & b24);                                                  \
+    a14 = b14 ^ (~b24 & b34);                                                  \
+    a24 = b24 ^ (~b34 & b44);                                                  \
+    a34 = b34 ^ (~b44 & b04);                                                  \
+    a44 = b44 ^ (~b04 & b14);                                                  \
+  } while (0)
+#else
+#define KECCAK_COMPLEMENT()                                                    \
+  do {                                                                         \
+    a10 = ~a10;                                                                \
+    a20 = ~a20;                                                                \
+    a31 = ~a31;                                                                \
+    a22 = ~a22;                                                                \
+    a23 = ~a23;                                                                \
+    a04 = ~a04;                                                                \
+  } while (0)
+#define KECCAK_CHI()                                                           \
+  do {                                                                         \
+    a00 = b00 ^ (b10 | b20);                                                   \
+    a10 = b10 ^ (~b20 | b30);                                                  \
+    a20 = b20 ^ (b30 & b40);                                                   \
+    a30 = b30 ^ (b40 | b00);                                                   \
+    a40 = b40 ^ (b00 & b10);                                                   \
+    a01 = b01 ^ (b11 | b21);                                                   \
+    a11 = b11 ^ (b21 & b31);                                                   \
+    a21 = b21 ^ (b31 | ~b41);                                                  \
+    a31 = b31 ^ (b41 | b01);                                                   \
+    a41 = b41 ^ (b01 & b11);                                                   \
+    a02 = b02 ^ (b12 | b22);                                                   \
+    a12 = b12 ^ (b22 & b32);                                                   \
+    a22 = b22 ^ (~b32 & b42);                                                  \
+    a32 = ~b32 ^ (b42 | b02);                                                  \
+    a42 = b42 ^ (b02 & b12);                                                   \
+    a03 = b03 ^ (b13 & b23);                                                   \
+    a13 = b13 ^ (b23 | b33);                                                   \
+    a23 = b23 ^ (~b33 | b43);                                                  \
+    a33 = ~b33 ^ (b43 & b03);                                                  \
+    a43 = b43 ^ (b03 | b13);                                                   \
+    a04 = b04 ^ (~b14 & b24);                                                  \
+    a14 = ~b14 ^ (b24 | b34);                                                  \
+    a24 = b24 ^ (b34 & b44);                                                   \
+    a34 = b34 ^ (b44 | b04);                                                   \
+    a44 = b44 ^ (b04 & b14);                                                   \
+  } while (0)
+#endif
+
+// one round of Keccak-f[1600] on the lanes a<x><y>: theta into c and d, rho
+// and pi into b, then chi and iota back into a.
+#define KECCAK_ROUND(rc)                                                       \
+  do {                                                                         \
+    c0 = a00 ^ a01 ^ a02 ^ a03 ^ a04;                                          \
+    c1 = a10 ^ a11 ^ a12 ^ a13 ^ a14;                                          \
+    c2 = a20 ^ a21 ^ a22 ^ a23 ^ a24;                                          \
+    c3 = a30 ^ a31 ^ a32 ^ a33 ^ a34;                                          \
+    c4 = a40 ^ a41 ^ a42 ^ a43 ^ a44;                                          \
+    d0 = c4 ^ Rotl64(c1, 1);                                                   \
+    d1 = c0 ^ Rotl64(c2, 1);                                                   \
+    d2 = c1 ^ Rotl64(c3, 1);                                                   \
+    d3 = c2 ^ Rotl64(c4, 1);                                                   \
+    d4 = c3 ^ Rotl64(c0, 1);                                                   \
+    b00 = a00 ^ d0;                                                            \
+    b13 = Rotl64(a01 ^ d0, 36);                                                \
+    b21 = Rotl64(a02 ^ d0, 3);                                                 \
+    b34 = Rotl64(a03 ^ d0, 41);                                                \
+    b42 = Rotl64(a04 ^ d0, 18);                                                \
+    b02 = Rotl64(a10 ^ d1, 1);                                                 \
+    b10 = Rotl64(a11 ^ d1, 44);                                                \
+    b23 = Rotl64(a12 ^ d1, 10);                                                \
+    b31 = Rotl64(a13 ^ d1, 45);                                                \
+    b44 = Rotl64(a14 ^ d1, 2);                                                 \
+    b04 = Rotl64(a20 ^ d2, 62);                                                \
+    b12 = Rotl64(a21 ^ d2, 6);                                                 \
+    b20 = Rotl64(a22 ^ d2, 43);                                                \
+    b33 = Rotl64(a23 ^ d2, 15);                                                \
+    b41 = Rotl64(a24 ^ d2, 61);                                                \
+    b01 = Rotl64(a30 ^ d3, 28);                                                \
+    b14 = Rotl64(a31 ^ d3, 55);                                                \
+    b22 = Rotl64(a32 ^ d3, 25);                                                \
+    b30 = Rotl64(a33 ^ d3, 21);                                                \
+    b43 = Rotl64(a34 ^ d3, 56);                                                \
+    b03 = Rotl64(a40 ^ d4, 27);                                                \
+    b11 = Rotl64(a41 ^ d4, 20);                                                \
+    b24 = Rotl64(a42 ^ d4, 39);                                                \
+    b32 = Rotl64(a43 ^ d4, 8);                                                 \
+    b40 = Rotl64(a44 ^ d4, 14);                                                \
+    KECCAK_CHI();                                                              \
+    a00 ^= (rc);                                                               \
+  } while (0)
 
-static const unsigned int keccakf_piln[24] = {10, 7,  11, 17, 18, 3,  5,  16,
-                                              8,  21, 24, 4,  15, 23, 19, 13,
-                                              12, 2,  20, 14, 22, 9,  6,  1};
+template <typename Lane>
+static inline void keccakf(Lane state[25]) {
+  Lane a00 = state[0], a10 = state[1], a20 = state[2],
+      a30 = state[3], a40 = state[4];
+  Lane a01 = state[5], a11 = state[6], a21 = state[7],
+      a31 = state[8], a41 = state[9];
+  Lane a02 = state[10], a12 = state[11], a22 = state[12],
+      a32 = state[13], a42 = state[14];
+  Lane a03 = state[15], a13 = state[16], a23 = state[17],
+      a33 = state[18], a43 = state[19];
+  Lane a04 = state[20], a14 = state[21], a24 = state[22],
+      a34 = state[23], a44 = state[24];
+  Lane b00, b10, b20, b30, b40, b01, b11, b21, b31, b41, b02, b12, b22, b32,
+      b42, b03, b13, b23, b33, b43, b04, b14, b24, b34, b44;
+  Lane c0, c1, c2, c3, c4, d0, d1, d2, d3, d4;
 
-static inline uint64_t rotl64(uint64_t x, uint64_t y) {
-  return (x << y) | (x >> ((sizeof(uint64_t) * 8) - y));
+  KECCAK_COMPLEMENT();
+  for (std::size_t round = 0; round < 24; round += 2) {
+    KECCAK_ROUND(keccakf_rndc[round]);
+    KECCAK_ROUND(keccakf_rndc[round + 1]);
+  }
+  KECCAK_COMPLEMENT();
+
+  state[0] = a00; state[1] = a10; state[2] = a20;
+  state[3] = a30; state[4] = a40;
+  state[5] = a01; state[6] = a11; state[7] = a21;
+  state[8] = a31; state[9] = a41;
+  state[10] = a02; state[11] = a12; state[12] = a22;
+  state[13] = a32; state[14] = a42;
+  state[15] = a03; state[16] = a13; state[17] = a23;
+  state[18] = a33; state[19] = a43;
+  state[20] = a04; state[21] = a14; state[22] = a24;
+  state[23] = a34; state[24] = a44;
 }
 
-static inline void keccakf(uint64_t state[25]) {
-  uint64_t t;
-  uint64_t bc[5];
+#undef KECCAK_ROUND
+#undef KECCAK_CHI
+#undef KECCAK_COMPLEMENT
+
+// reads a little-endian 64-bit lane.
+static inline uint64_t Load64(const uint8_t* p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+#else
+  uint64_t v = 0;
+  for (std::size_t i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+  return v;
+#endif
+}
+
+#if defined(__x86_64__)
+// Keccak-f[1600] on one state with AVX-512: plane y of the state is lanes 0
+// to 4 of register a<y>. Theta and chi are one vpternlogq per plane and rho
+// is one vprolvq per plane, which leaves pi and the lane rotations of theta
+// and chi to permutes.
+__attribute__((target("avx512f"))) static void KeccakF1600Avx512(
+    uint64_t state[25]) {
+  const __mmask8 plane = 0x1f;
+  const __m512i prev = _mm512_setr_epi64(4, 0, 1, 2, 3, 5, 6, 7);
+  const __m512i next = _mm512_setr_epi64(1, 2, 3, 4, 0, 5, 6, 7);
+  const __m512i next2 = _mm512_setr_epi64(2, 3, 4, 0, 1, 5, 6, 7);
+  const __m512i rho0 = _mm512_setr_epi64(0, 1, 62, 28, 27, 0, 0, 0);
+  const __m512i rho1 = _mm512_setr_epi64(36, 44, 6, 55, 20, 0, 0, 0);
+  const __m512i rho2 = _mm512_setr_epi64(3, 10, 43, 25, 39, 0, 0, 0);
+  const __m512i rho3 = _mm512_setr_epi64(41, 45, 15, 21, 8, 0, 0, 0);
+  const __m512i rho4 = _mm512_setr_epi64(18, 2, 61, 56, 14, 0, 0, 0);
+  // pi moves lane x of plane y to lane y of plane 2x + 3y. Plane Y of the
+  // result takes lane 3Y + y of every plane y, which is gathered from planes
+  // 0 and 1 and from planes 2 and 3 interleaved, and from plane 4.
+  const __m512i pi01 = _mm512_setr_epi64(0, 9, 1, 10, 2, 11, 3, 12);
+  const __m512i pi01_4 = _mm512_setr_epi64(4, 8, 0, 0, 0, 0, 0, 0);
+  const __m512i pi23 = _mm512_setr_epi64(2, 11, 3, 12, 4, 8, 0, 9);
+  const __m512i pi23_4 = _mm512_setr_epi64(1, 10, 0, 0, 0, 0, 0, 0);
+  const __m512i pick0 = _mm512_setr_epi64(0, 1, 8, 9, 0, 5, 6, 7);
+  const __m512i pick1 = _mm512_setr_epi64(2, 3, 10, 11, 0, 5, 6, 7);
+  const __m512i pick2 = _mm512_setr_epi64(4, 5, 12, 13, 0, 5, 6, 7);
+  const __m512i pick3 = _mm512_setr_epi64(6, 7, 14, 15, 0, 5, 6, 7);
+
+  __m512i a0 = _mm512_maskz_loadu_epi64(plane, state);
+  __m512i a1 = _mm512_maskz_loadu_epi64(plane, state + 5);
+  __m512i a2 = _mm512_maskz_loadu_epi64(plane, state + 10);
+  __m512i a3 = _mm512_maskz_loadu_epi64(plane, state + 15);
+  __m512i a4 = _mm512_maskz_loadu_epi64(plane, state + 20);
 
   for (std::size_t round = 0; round < 24; ++round) {
-    for (std::size_t i = 0; i < 5; ++i)
-      bc[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^
-              state[i + 20];
+    // theta
+    __m512i c = _mm512_ternarylogic_epi64(a0, a1, a2, 0x96);
+    c = _mm512_ternarylogic_epi64(c, a3, a4, 0x96);
+    const __m512i cp = _mm512_permutexvar_epi64(prev, c);
+    const __m512i cn = _mm512_rol_epi64(_mm512_permutexvar_epi64(next, c), 1);
+    a0 = _mm512_ternarylogic_epi64(a0, cp, cn, 0x96);
+    a1 = _mm512_ternarylogic_epi64(a1, cp, cn, 0x96);
+    a2 = _mm512_ternarylogic_epi64(a2, cp, cn, 0x96);
+    a3 = _mm512_ternarylogic_epi64(a3, cp, cn, 0x96);
+    a4 = _mm512_ternarylogic_epi64(a4, cp, cn, 0x96);
+
+    // rho
+    a0 = _mm512_rolv_epi64(a0, rho0);
+    a1 = _mm512_rolv_epi64(a1, rho1);
+    a2 = _mm512_rolv_epi64(a2, rho2);
+    a3 = _mm512_rolv_epi64(a3, rho3);
+    a4 = _mm512_rolv_epi64(a4, rho4);
+
+    // pi
+    const __m512i u01 = _mm512_permutex2var_epi64(a0, pi01, a1);
+    const __m512i v01 = _mm512_permutex2var_epi64(a0, pi01_4, a1);
+    const __m512i u23 = _mm512_permutex2var_epi64(a2, pi23, a3);
+    const __m512i v23 = _mm512_permutex2var_epi64(a2, pi23_4, a3);
+    __m512i b0 = _mm512_permutex2var_epi64(u01, pick0, u23);
+    __m512i b2 = _mm512_permutex2var_epi64(u01, pick1, u23);
+    __m512i b4 = _mm512_permutex2var_epi64(u01, pick2, u23);
+    __m512i b1 = _mm512_permutex2var_epi64(u01, pick3, u23);
+    __m512i b3 = _mm512_permutex2var_epi64(v01, pick0, v23);
+    b0 = _mm512_mask_permutexvar_epi64(b0, 0x10, _mm512_set1_epi64(4), a4);
+    b2 = _mm512_mask_permutexvar_epi64(b2, 0x10, _mm512_set1_epi64(0), a4);
+    b4 = _mm512_mask_permutexvar_epi64(b4, 0x10, _mm512_set1_epi64(1), a4);
+    b1 = _mm512_mask_permutexvar_epi64(b1, 0x10, _mm512_set1_epi64(2), a4);
+    b3 = _mm512_mask_permutexvar_epi64(b3, 0x10, _mm512_set1_epi64(3), a4);
+
+    // chi: b ^ (~next & next2)
+    a0 = _mm512_ternarylogic_epi64(b0, _mm512_permutexvar_epi64(next, b0),
+                                   _mm512_permutexvar_epi64(next2, b0), 0xd2);
+    a1 = _mm512_ternarylogic_epi64(b1, _mm512_permutexvar_epi64(next, b1),
+                                   _mm512_permutexvar_epi64(next2, b1), 0xd2);
+    a2 = _mm512_ternarylogic_epi64(b2, _mm512_permutexvar_epi64(next, b2),
+                                   _mm512_permutexvar_epi64(next2, b2), 0xd2);
+    a3 = _mm512_ternarylogic_epi64(b3, _mm512_permutexvar_epi64(next, b3),
+                                   _mm512_permutexvar_epi64(next2, b3), 0xd2);
+    a4 = _mm512_ternarylogic_epi64(b4, _mm512_permutexvar_epi64(next, b4),
+                                   _mm512_permutexvar_epi64(next2, b4), 0xd2);
+
+    // iota
+    a0 = _mm512_mask_xor_epi64(a0, 1, a0,
+                               _mm512_set1_epi64(keccakf_rndc[round]));
+  }
+
+  _mm512_mask_storeu_epi64(state, plane, a0);
+  _mm512_mask_storeu_epi64(state + 5, plane, a1);
+  _mm512_mask_storeu_epi64(state + 10, plane, a2);
+  _mm512_mask_storeu_epi64(state + 15, plane, a3);
+  _mm512_mask_storeu_epi64(state + 20, plane, a4);
+}
+#endif
+
+void shf::KeccakF1600Scalar(uint64_t state[25]) { keccakf(state); }
+
+// the permutation of a single state, picked for the CPU the first time it is
+// used. The check is made at run time, so a binary built for any x86-64 uses
+// AVX-512 where it is available.
+static inline void Permute(uint64_t state[25]) {
+  static void (*const permute)(uint64_t*) = [] {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return KeccakF1600Avx512;
+#endif
+    return shf::KeccakF1600Scalar;
+  }();
+  permute(state);
+}
 
-    for (std::size_t i = 0; i < 5; ++i) {
-      t = bc[(i + 4) % 5] ^ rotl64(bc[(i + 1) % 5], 1);
-      for (std::size_t j = 0; j < 25; j += 5) state[j + i] ^= t;
+void shf::KeccakF1600(uint64_t state[25]) { Permute(state); }
+
+// runs keccakf on N states at once, with lane i of every state in one vector.
+template <typename Lanes, std::size_t N>
+static inline void KeccakLockstep(uint64_t* const* states) {
+  Lanes lanes[25];
+  for (std::size_t i = 0; i < 25; ++i)
+    for (std::size_t j = 0; j < N; ++j) lanes[i][j] = states[j][i];
+  keccakf(lanes);
+  for (std::size_t i = 0; i < 25; ++i)
+    for (std::size_t j = 0; j < N; ++j) states[j][i] = lanes[i][j];
+}
+
+// vectors are only used when the target has registers that wide; otherwise
+// the compiler would split them and pass them around in memory.
+#if defined(__AVX2__)
+typedef uint64_t Lanes4 __attribute__((vector_size(32)));
+#endif
+#if defined(__AVX512F__)
+typedef uint64_t Lanes8 __attribute__((vector_size(64)));
+#endif
+
+void shf::KeccakF1600x4(uint64_t* const states[4]) {
+#if defined(__AVX2__)
+  KeccakLockstep<Lanes4, 4>(states);
+#else
+  for (std::size_t i = 0; i < 4; ++i) Permute(states[i]);
+#endif
+}
+
+void shf::KeccakF1600x8(uint64_t* const states[8]) {
+#if defined(__AVX512F__)
+  KeccakLockstep<Lanes8, 8>(states);
+#else
+  KeccakF1600x4(states);
+  KeccakF1600x4(states + 4);
+#endif
+}
+
+// permutes any number of states, as many at once as the target allows.
+static inline void PermuteMany(uint64_t* const* states, std::size_t n) {
+  std::size_t i = 0;
+#if defined(__AVX512F__)
+  for (; i + 8 <= n; i += 8) shf::KeccakF1600x8(states + i);
+#endif
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) shf::KeccakF1600x4(states + i);
+#endif
+  for (; i < n; ++i) Permute(states[i]);
+}
+
+static const uint32_t sha256_iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                      0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                      0x1f83d9ab, 0x5be0cd19};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t Rotr32(uint32_t x, unsigned int y) {
+  return (x >> y) | (x << (32 - y));
+}
+
+#if defined(SHF_SHA_NI)
+
+// SHA-256 compression of n blocks with the SHA extensions. The state is kept
+// as ABEF and CDGH, the order sha256rnds2 works on.
+static void Sha256Blocks(uint32_t state[8], const uint8_t* data,
+                         std::size_t n) {
+#if defined(__AVX__)
+  // the SHA instructions only have legacy SSE encodings, which are slow while
+  // the upper halves of the vector registers are dirty.
+  _mm256_zeroupper();
+#endif
+  const __m128i mask =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i t = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+  __m128i s1 = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+  __m128i s0 = _mm_alignr_epi8(t, s1, 8);
+  s1 = _mm_blend_epi16(s1, t, 0xF0);
+
+  for (std::size_t b = 0; b < n; ++b, data += 64) {
+    const __m128i abef = s0;
+    const __m128i cdgh = s1;
+    __m128i w[4];
+    for (std::size_t i = 0; i < 4; ++i)
+      w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)),
+          mask);
+
+    // four rounds at a time; w holds the next 16 words of the schedule.
+    for (std::size_t j = 0; j < 16; ++j) {
+      __m128i msg = _mm_add_epi32(
+          w[j & 3],
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(sha256_k + 4 * j)));
+      s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+      msg = _mm_shuffle_epi32(msg, 0x0E);
+      s0 = _mm_sha256rnds2_epu32(s0, s1, msg);
+      if (j < 12) {
+        const __m128i w7 = _mm_alignr_epi8(w[(j + 3) & 3], w[(j + 2) & 3], 4);
+        w[j & 3] = _mm_sha256msg2_epu32(
+            _mm_add_epi32(_mm_sha256msg1_epu32(w[j & 3], w[(j + 1) & 3]), w7),
+            w[(j + 3) & 3]);
+      }
     }
 
-    t = state[1];
-    for (std::size_t i = 0; i < 24; ++i) {
-      const uint64_t v = keccakf_piln[i];
-      bc[0] = state[v];
-      state[v] = rotl64(t, keccakf_rotc[i]);
-      t = bc[0];
+    s0 = _mm_add_epi32(s0, abef);
+    s1 = _mm_add_epi32(s1, cdgh);
+  }
+
+  t = _mm_shuffle_epi32(s0, 0x1B);
+  s1 = _mm_shuffle_epi32(s1, 0xB1);
+  s0 = _mm_blend_epi16(t, s1, 0xF0);
+  s1 = _mm_alignr_epi8(s1, t, 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), s0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), s1);
+}
+
+#else
+
+static void Sha256Blocks(uint32_t state[8], const uint8_t* data,
+                         std::size_t n) {
+  uint32_t w[64];
+  for (std::size_t b = 0; b < n; ++b, data += 64) {
+    for (std::size_t i = 0; i < 16; ++i)
+      w[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 |
+             (uint32_t)data[4 * i + 2] << 8 | (uint32_t)data[4 * i + 3];
+    for (std::size_t i = 16; i < 64; ++i) {
+      const uint32_t s0 =
+          Rotr32(w[i - 15], 7) ^ Rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 =
+          Rotr32(w[i - 2], 17) ^ Rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
     }
 
-    for (std::size_t j = 0; j < 25; j += 5) {
-      for (std::size_t i = 0; i < 5; ++i) bc[i] = state[j + i];
-      for (std::size_t i = 0; i < 5; ++i)
-        state[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+    uint32_t a = state[0], b1 = state[1], c = state[2], d = state[3],
+             e = state[4], f = state[5], g = state[6], h = state[7];
+    for (std::size_t i = 0; i < 64; ++i) {
+      const uint32_t t1 = h + (Rotr32(e, 6) ^ Rotr32(e, 11) ^ Rotr32(e, 25)) +
+                          ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+      const uint32_t t2 = (Rotr32(a, 2) ^ Rotr32(a, 13) ^ Rotr32(a, 22)) +
+                          ((a & b1) ^ (a & c) ^ (b1 & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b1;
+      b1 = a;
+      a = t1 + t2;
     }
+    state[0] += a;
+    state[1] += b1;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#endif
+
+shf::Sha256::Sha256() { std::memcpy(mState, sha256_iv, sizeof(mState)); }
+
+void shf::Sha256::Update(const uint8_t* data, std::size_t n) {
+  std::size_t used = mLength % sizeof(mBlock);
+  mLength += n;
+
+  if (used) {
+    const std::size_t m = std::min(n, sizeof(mBlock) - used);
+    std::memcpy(mBlock + used, data, m);
+    data += m;
+    n -= m;
+    if (used + m < sizeof(mBlock)) return;
+    Sha256Blocks(mState, mBlock, 1);
+  }
+
+  const std::size_t blocks = n / sizeof(mBlock);
+  Sha256Blocks(mState, data, blocks);
+  data += blocks * sizeof(mBlock);
+  std::memcpy(mBlock, data, n - blocks * sizeof(mBlock));
+}
+
+shf::Digest shf::Sha256::Finalize() {
+  const uint64_t bits = mLength * 8;
+  uint8_t pad[sizeof(mBlock) + 8] = {0x80};
+  const std::size_t used = mLength % sizeof(mBlock);
+  const std::size_t n = (used < 56 ? 56 : 120) - used;
+  for (std::size_t i = 0; i < 8; ++i)
+    pad[n + i] = (uint8_t)(bits >> (56 - 8 * i));
+  Update(pad, n + 8);
 
-    state[0] ^= keccakf_rndc[round];
+  Digest digest;
+  for (std::size_t i = 0; i < digest.size(); ++i)
+    digest[i] = (uint8_t)(mState[i / 4] >> (24 - 8 * (i % 4)));
+  return digest;
+}
+
+// the order of the message words in each round of BLAKE3. BLAKE3 shares
+// its IV with SHA-256.
+static const uint8_t blake3_schedule[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13}};
+
+static constexpr uint32_t kBlake3ChunkStart = 1;
+static constexpr uint32_t kBlake3ChunkEnd = 2;
+static constexpr uint32_t kBlake3Parent = 4;
+static constexpr uint32_t kBlake3Root = 8;
+static constexpr std::size_t kBlake3ChunkSize = 1024;
+
+static inline uint32_t Load32(const uint8_t* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static inline void Blake3G(uint32_t v[16], std::size_t a, std::size_t b,
+                           std::size_t c, std::size_t d, uint32_t x,
+                           uint32_t y) {
+  v[a] = v[a] + v[b] + x;
+  v[d] = Rotr32(v[d] ^ v[a], 16);
+  v[c] = v[c] + v[d];
+  v[b] = Rotr32(v[b] ^ v[c], 12);
+  v[a] = v[a] + v[b] + y;
+  v[d] = Rotr32(v[d] ^ v[a], 8);
+  v[c] = v[c] + v[d];
+  v[b] = Rotr32(v[b] ^ v[c], 7);
+}
+
+// the BLAKE3 compression function. The first half of out is the chaining
+// value, and all of it is a block of output for the root.
+static void Blake3Compress(const uint32_t cv[8], const uint32_t m[16],
+                           uint64_t counter, uint32_t block_len,
+                           uint32_t flags, uint32_t out[16]) {
+  uint32_t v[16] = {cv[0],
+                    cv[1],
+                    cv[2],
+                    cv[3],
+                    cv[4],
+                    cv[5],
+                    cv[6],
+                    cv[7],
+                    sha256_iv[0],
+                    sha256_iv[1],
+                    sha256_iv[2],
+                    sha256_iv[3],
+                    (uint32_t)counter,
+                    (uint32_t)(counter >> 32),
+                    block_len,
+                    flags};
+  for (const auto& s : blake3_schedule) {
+    Blake3G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    Blake3G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    Blake3G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    Blake3G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    Blake3G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    Blake3G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    Blake3G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    Blake3G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+  }
+  for (std::size_t i = 0; i < 8; ++i) {
+    out[i] = v[i] ^ v[i + 8];
+    out[i + 8] = v[i + 8] ^ cv[i];
   }
 }
 
+static inline void Blake3LoadBlock(const uint8_t* data, uint32_t m[16]) {
+  for (std::size_t i = 0; i < 16; ++i) m[i] = Load32(data + 4 * i);
+}
+
+shf::Blake3::Blake3() { std::memcpy(mCv, sha256_iv, sizeof(mCv)); }
+
+shf::Blake3::Node shf::Blake3::ChunkNode() const {
+  Node node;
+  std::memcpy(node.cv, mCv, sizeof(node.cv));
+  Blake3LoadBlock(mBlock, node.block);
+  node.counter = mChunkCounter;
+  node.block_len = mBlockLen;
+  node.flags = kBlake3ChunkEnd | (mBlocksCompressed ? 0 : kBlake3ChunkStart);
+  return node;
+}
+
+// merges the chaining value of the full current chunk into the subtrees to
+// its left, and starts the next chunk.
+void shf::Blake3::AddChunk() {
+  const Node node = ChunkNode();
+  uint32_t out[16];
+  Blake3Compress(node.cv, node.block, node.counter, node.block_len, node.flags,
+                 out);
+
+  // one merge for every trailing zero bit of the number of chunks.
+  uint64_t chunks = ++mChunkCounter;
+  uint32_t m[16];
+  while (!(chunks & 1)) {
+    std::memcpy(m, mStack[--mStackLen], 8 * sizeof(uint32_t));
+    std::memcpy(m + 8, out, 8 * sizeof(uint32_t));
+    Blake3Compress(sha256_iv, m, 0, 64, kBlake3Parent, out);
+    chunks >>= 1;
+  }
+  std::memcpy(mStack[mStackLen++], out, 8 * sizeof(uint32_t));
+
+  std::memcpy(mCv, sha256_iv, sizeof(mCv));
+  std::memset(mBlock, 0, sizeof(mBlock));
+  mBlockLen = 0;
+  mBlocksCompressed = 0;
+}
+
+// a full block is only compressed when more input arrives, since the last
+// block of a chunk is compressed with different flags.
+void shf::Blake3::Update(const uint8_t* data, std::size_t n) {
+  while (n) {
+    if (mBlockLen == sizeof(mBlock)) {
+      if ((mBlocksCompressed + 1) * sizeof(mBlock) == kBlake3ChunkSize) {
+        AddChunk();
+      } else {
+        uint32_t m[16], out[16];
+        Blake3LoadBlock(mBlock, m);
+        Blake3Compress(mCv, m, mChunkCounter, sizeof(mBlock),
+                       mBlocksCompressed ? 0 : kBlake3ChunkStart, out);
+        std::memcpy(mCv, out, sizeof(mCv));
+        std::memset(mBlock, 0, sizeof(mBlock));
+        mBlockLen = 0;
+        mBlocksCompressed++;
+      }
+    }
+    const std::size_t m = std::min(n, sizeof(mBlock) - mBlockLen);
+    std::memcpy(mBlock + mBlockLen, data, m);
+    mBlockLen += m;
+    data += m;
+    n -= m;
+  }
+}
+
+shf::Blake3::Node shf::Blake3::RootNode() const {
+  Node node = ChunkNode();
+  for (std::size_t i = mStackLen; i-- > 0;) {
+    uint32_t out[16];
+    Blake3Compress(node.cv, node.block, node.counter, node.block_len,
+                   node.flags, out);
+    std::memcpy(node.block, mStack[i], 8 * sizeof(uint32_t));
+    std::memcpy(node.block + 8, out, 8 * sizeof(uint32_t));
+    std::memcpy(node.cv, sha256_iv, sizeof(node.cv));
+    node.counter = 0;
+    node.block_len = 64;
+    node.flags = kBlake3Parent;
+  }
+  return node;
+}
+
+shf::Digest shf::Blake3::Finalize() const {
+  const Node root = RootNode();
+  uint32_t out[16];
+  Blake3Compress(root.cv, root.block, 0, root.block_len,
+                 root.flags | kBlake3Root, out);
+  Digest digest;
+  for (std::size_t i = 0; i < digest.size(); ++i)
+    digest[i] = (uint8_t)(out[i / 4] >> (8 * (i % 4)));
+  return digest;
+}
+
+void shf::Blake3::Squeeze(uint8_t* out, std::size_t n) {
+  if (!mSqueezing) {
+    mRoot = RootNode();
+    mRoot.counter = 0;
+    mSqueezing = true;
+    mOutputOffset = sizeof(mOutput);
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    if (mOutputOffset == sizeof(mOutput)) {
+      uint32_t words[16];
+      Blake3Compress(mRoot.cv, mRoot.block, mRoot.counter++, mRoot.block_len,
+                     mRoot.flags | kBlake3Root, words);
+      for (std::size_t j = 0; j < sizeof(mOutput); ++j)
+        mOutput[j] = (uint8_t)(words[j / 4] >> (8 * (j % 4)));
+      mOutputOffset = 0;
+    }
+    out[i] = mOutput[mOutputOffset++];
+  }
+}
+
+// a full block is only permuted when the next word arrives or the hash is
+// finalized, which lets UpdateMany permute the blocks of many hashes at once.
+inline void shf::Hash::AbsorbWord(uint64_t word) {
+  Flush();
+  mState[mWordIndex++] ^= word;
+}
+
+inline void shf::Hash::Flush() {
+  if (mWordIndex == kCutoff) {
+    Permute(mState);
+    mWordIndex = 0;
+  }
+}
+
+inline void shf::Hash::Pad(uint64_t suffix) {
+  mState[mWordIndex] ^= mSaved ^ (suffix << (mByteIndex * 8));
+  mState[kCutoff - 1] ^= 0x8000000000000000ULL;
+}
+
+void shf::Hash::FlushMany(shf::Hash* hashes, std::size_t count) {
+  // only Keccak hashes are ever left with a full block.
+  std::vector<uint64_t*> states;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (hashes[i].mWordIndex == kCutoff) {
+      states.emplace_back(hashes[i].mState);
+      hashes[i].mWordIndex = 0;
+    }
+  }
+  PermuteMany(states.data(), states.size());
+}
+
 shf::Hash& shf::Hash::Update(const uint8_t* bytes, std::size_t nbytes) {
+  if (mBackend == HashBackend::kSha256) {
+    mSha.Update(bytes, nbytes);
+    return *this;
+  }
+  if (mBackend == HashBackend::kBlake3) {
+    mBlake.Update(bytes, nbytes);
+    return *this;
+  }
+
   unsigned int old_tail = (8 - mByteIndex) & 7;
   const uint8_t* p = bytes;
 
@@ -70,32 +759,16 @@ shf::Hash& shf::Hash::Update(const uint8_t* bytes, std::size_t nbytes) {
     nbytes -= old_tail;
     while (old_tail--) mSaved |= (uint64_t)(*(p++)) << ((mByteIndex++) * 8);
 
-    mState[mWordIndex] ^= mSaved;
+    AbsorbWord(mSaved);
     mByteIndex = 0;
     mSaved = 0;
-
-    if (++mWordIndex == kCutoff) {
-      keccakf(mState);
-      mWordIndex = 0;
-    }
   }
 
   std::size_t words = nbytes / sizeof(uint64_t);
   unsigned int tail = nbytes - words * sizeof(uint64_t);
 
   for (std::size_t i = 0; i < words; ++i) {
-    const uint64_t t =
-        (uint64_t)(p[0]) | ((uint64_t)(p[1]) << 8 * 1) |
-        ((uint64_t)(p[1]) << 8 * 2) | ((uint64_t)(p[1]) << 8 * 3) |
-        ((uint64_t)(p[1]) << 8 * 4) | ((uint64_t)(p[1]) << 8 * 5) |
-        ((uint64_t)(p[1]) << 8 * 6) | ((uint64_t)(p[1]) << 8 * 7);
-
-    mState[mWordIndex] ^= t;
-
-    if (++mWordIndex == kCutoff) {
-      keccakf(mState);
-      mWordIndex = 0;
-    }
+    AbsorbWord(Load64(p));
     p += sizeof(uint64_t);
   }
 
@@ -104,12 +777,54 @@ shf::Hash& shf::Hash::Update(const uint8_t* bytes, std::size_t nbytes) {
   return *this;
 }
 
+void shf::Hash::UpdateMany(shf::Hash* hashes, std::size_t count,
+                           const uint8_t* data, std::size_t n) {
+  // every round absorbs up to the end of the current block of each hash, and
+  // permutes the full blocks together at the start of the next round.
+  std::vector<std::size_t> done(count, 0);
+  bool more = true;
+  while (more) {
+    FlushMany(hashes, count);
+    more = false;
+    for (std::size_t i = 0; i < count; ++i) {
+      Hash& hash = hashes[i];
+      const std::size_t room =
+          (kCutoff - hash.mWordIndex) * sizeof(uint64_t) - hash.mByteIndex;
+      const std::size_t m = std::min(room, n - done[i]);
+      hash.Update(data + i * n + done[i], m);
+      done[i] += m;
+      more |= done[i] < n;
+    }
+  }
+}
+
 shf::Hash& shf::Hash::Update(const shf::Point& point) {
-  // TODO: figure out if this data can be allocated automatically.
-  uint8_t* data = new uint8_t[Point::ByteSize()];
+  uint8_t data[Point::ByteSize()];
   point.Write(data);
   Update(data, Point::ByteSize());
-  delete[] data;
+  return *this;
+}
+
+// ciphertexts absorbed per call to the sponge when hashing a list.
+static constexpr std::size_t kCtxtBlockSize = 64;
+
+static inline void AbsorbCiphertexts(shf::Hash& hash, const shf::Ctxt* ctxts,
+                                     std::size_t n) {
+  const shf::Point* points[2 * kCtxtBlockSize];
+  uint8_t data[2 * kCtxtBlockSize * shf::Point::ByteSize()];
+  for (std::size_t i = 0; i < n; i += kCtxtBlockSize) {
+    const std::size_t m = std::min(kCtxtBlockSize, n - i);
+    for (std::size_t j = 0; j < m; ++j) {
+      points[2 * j] = &ctxts[i + j].U;
+      points[2 * j + 1] = &ctxts[i + j].V;
+    }
+    shf::Point::WriteBatch(points, 2 * m, data);
+    hash.Update(data, 2 * m * shf::Point::ByteSize());
+  }
+}
+
+shf::Hash& shf::Hash::Update(const std::vector<shf::Ctxt>& ctxts) {
+  AbsorbCiphertexts(*this, ctxts.data(), ctxts.size());
   return *this;
 }
 
@@ -122,11 +837,34 @@ shf::Hash& shf::Hash::Update(const shf::Scalar& scalar) {
 }
 
 shf::Digest shf::Hash::Finalize() {
-  uint64_t t = (uint64_t)(((uint64_t)(0x02 | (1 << 2))) << ((mByteIndex)*8));
-  mState[mWordIndex] ^= mSaved ^ t;
-  mState[kCutoff - 1] ^= 0x8000000000000000ULL;
-  keccakf(mState);
+  if (mBackend == HashBackend::kSha256) return mSha.Finalize();
+  if (mBackend == HashBackend::kBlake3) return mBlake.Finalize();
+  Flush();
+  Pad(kSha3Suffix);
+  Permute(mState);
+  return Output();
+}
 
+void shf::Hash::FinalizeMany(shf::Hash* hashes, std::size_t count,
+                             shf::Digest* digests) {
+  FlushMany(hashes, count);
+  std::vector<uint64_t*> states;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (hashes[i].mBackend == HashBackend::kKeccak) {
+      hashes[i].Pad(kSha3Suffix);
+      states.emplace_back(hashes[i].mState);
+    }
+  }
+  PermuteMany(states.data(), states.size());
+  for (std::size_t i = 0; i < count; ++i) {
+    if (hashes[i].mBackend == HashBackend::kKeccak)
+      digests[i] = hashes[i].Output();
+    else
+      digests[i] = hashes[i].Finalize();
+  }
+}
+
+shf::Digest shf::Hash::Output() {
   for (std::size_t i = 0; i < kStateSize; ++i) {
     const unsigned int t1 = (uint32_t)mState[i];
     const unsigned int t2 = (uint32_t)((mState[i] >> 16) >> 16);
@@ -147,14 +885,168 @@ shf::Digest shf::Hash::Finalize() {
   return digest;
 }
 
+void shf::Hash::Squeeze(uint8_t* out, std::size_t n) {
+  if (mBackend == HashBackend::kSha256) {
+    if (!mSqueezing) {
+      mShaSeed = mSha.Finalize();
+      mSqueezing = true;
+      mSqueezeOffset = mShaOutput.size();
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      if (mSqueezeOffset == mShaOutput.size()) {
+        uint8_t counter[8];
+        for (std::size_t j = 0; j < 8; ++j)
+          counter[j] = (uint8_t)(mShaCounter >> (56 - 8 * j));
+        Sha256 block;
+        block.Update(mShaSeed.data(), mShaSeed.size());
+        block.Update(counter, sizeof(counter));
+        mShaOutput = block.Finalize();
+        mShaCounter++;
+        mSqueezeOffset = 0;
+      }
+      out[i] = mShaOutput[mSqueezeOffset++];
+    }
+    return;
+  }
+
+  if (mBackend == HashBackend::kBlake3) {
+    if (!mSqueezing) {
+      // skip the block that holds the digest.
+      uint8_t block[64];
+      mBlake.Squeeze(block, sizeof(block));
+      mSqueezing = true;
+    }
+    mBlake.Squeeze(out, n);
+    return;
+  }
+
+  if (!mSqueezing) {
+    Flush();
+    Pad(kShakeSuffix);
+    Permute(mState);
+    mSqueezing = true;
+    mSqueezeOffset = 0;
+  }
+
+  for (std::size_t i = 0; i < n; ++i) {
+    if (mSqueezeOffset == kCutoff * sizeof(uint64_t)) {
+      Permute(mState);
+      mSqueezeOffset = 0;
+    }
+    const uint64_t word = mState[mSqueezeOffset / 8];
+    out[i] = (uint8_t)(word >> (8 * (mSqueezeOffset % 8)));
+    mSqueezeOffset++;
+  }
+}
+
+std::vector<shf::Scalar> shf::Hash::SqueezeScalars(std::size_t n) {
+  std::vector<Scalar> scalars;
+  scalars.reserve(n);
+  uint8_t bytes[Scalar::WideByteSize()];
+  for (std::size_t i = 0; i < n; ++i) {
+    Squeeze(bytes, sizeof(bytes));
+    scalars.emplace_back(Scalar::ReadWide(bytes));
+  }
+  return scalars;
+}
+
 bool shf::DigestEquals(const shf::Digest& a, const shf::Digest& b) {
   uint8_t equal = 0;
   for (std::size_t i = 0; i < shf::Hash::DigestSize(); ++i) equal |= a[i] ^ b[i];
   return equal == 0;
 }
 
+// absorbs the label and length of a list of ciphertexts.
+static inline void StartList(shf::Hash& hash, const std::string& label,
+                             std::size_t n) {
+  uint8_t header[8 + 8];
+  const uint64_t sizes[2] = {label.size(), n};
+  for (std::size_t i = 0; i < 16; ++i)
+    header[i] = (uint8_t)(sizes[i / 8] >> (8 * (7 - i % 8)));
+  hash.Update(header, sizeof(header));
+  hash.Update(reinterpret_cast<const uint8_t*>(label.data()), label.size());
+}
+
+shf::Digest shf::ListDigest(const std::string& label,
+                            const std::vector<shf::Ctxt>& ctxts,
+                            shf::HashBackend backend) {
+  Hash hash(backend);
+  StartList(hash, label, ctxts.size());
+  return hash.Update(ctxts).Finalize();
+}
+
+shf::Digest shf::ListDigest(const std::string& label, const uint8_t* encoded,
+                            std::size_t n, shf::HashBackend backend) {
+  Hash hash(backend);
+  StartList(hash, label, n);
+  return hash.Update(encoded, 2 * n * Point::ByteSize()).Finalize();
+}
+
+// ciphertexts per leaf of a tree digest.
+static constexpr std::size_t kTreeLeafSize = 4096;
+
+// hashes every leaf of n ciphertexts with absorb(hash, begin, end) and
+// combines the leaf digests under the label.
+template <typename Absorb>
+static inline shf::Digest TreeDigest(const std::string& label, std::size_t n,
+                                     shf::ThreadPool* pool,
+                                     shf::HashBackend backend,
+                                     const Absorb& absorb) {
+  const std::size_t leaves = (n + kTreeLeafSize - 1) / kTreeLeafSize;
+  std::vector<shf::Digest> digests(leaves);
+  shf::ParallelFor(pool, leaves, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      shf::Hash leaf(backend);
+      absorb(leaf, i * kTreeLeafSize, std::min(n, (i + 1) * kTreeLeafSize));
+      digests[i] = leaf.Finalize();
+    }
+  });
+
+  shf::Hash root(backend);
+  StartList(root, label, n);
+  for (const auto& d : digests) root.Update(d.data(), d.size());
+  return root.Finalize();
+}
+
+shf::Digest shf::TreeListDigest(const std::string& label,
+                                const std::vector<shf::Ctxt>& ctxts,
+                                shf::ThreadPool* pool,
+                                shf::HashBackend backend) {
+  return TreeDigest(label, ctxts.size(), pool, backend,
+                    [&](Hash& hash, std::size_t begin, std::size_t end) {
+                      AbsorbCiphertexts(hash, ctxts.data() + begin,
+                                        end - begin);
+                    });
+}
+
+shf::Digest shf::TreeListDigest(const std::string& label,
+                                const uint8_t* encoded, std::size_t n,
+                                shf::ThreadPool* pool,
+                                shf::HashBackend backend) {
+  const std::size_t size = 2 * Point::ByteSize();
+  return TreeDigest(label, n, pool, backend,
+                    [&](Hash& hash, std::size_t begin, std::size_t end) {
+                      hash.Update(encoded + begin * size,
+                                  (end - begin) * size);
+                    });
+}
+
 shf::Scalar shf::ScalarFromHash(const shf::Hash& hash) {
   auto copy(hash);
   const auto d = copy.Finalize();
   return shf::Scalar::Read(d.data());
 }
+
+void shf::ScalarFromHashes(const shf::Hash* hashes, std::size_t n,
+                           shf::Scalar* out) {
+  std::vector<Hash> copies(hashes, hashes + n);
+  std::vector<Digest> digests(n);
+  Hash::FinalizeMany(copies.data(), n, digests.data());
+  for (std::size_t i = 0; i < n; ++i) out[i] = Scalar::Read(digests[i].data());
+}
+
+std::vector<shf::Scalar> shf::ScalarsFromHash(const shf::Hash& hash,
+                                              std::size_t n) {
+  auto copy(hash);
+  return copy.SqueezeScalars(n);
+}
@@ -3,8 +3,12 @@
 
 #include <array>
 #include <cstdint>
+#include <string>
+#include <vector>
 
+#include "cipher.h"
 #include "curve.h"
+#include "threadpool.h"
 
 namespace shf {
 
@@ -12,32 +16,343 @@ using Digest = std::array<uint8_t, 32>;
 
 bool DigestEquals(const Digest& a, const Digest& b);
 
+/**
+ * @brief The hash function behind a Hash.
+ *
+ * kKeccak is SHA3-256, with SHAKE256 for squeezing. kSha256 is SHA-256,
+ * computed with the SHA extensions when the target has them. kBlake3 is
+ * BLAKE3, with its own extendable output for squeezing. The backends give
+ * unrelated transcripts, so a proof verifies only with the backend it was
+ * created with.
+ */
+enum class HashBackend : uint8_t {
+  kKeccak = 0,
+  kSha256 = 1,
+  kBlake3 = 2,
+};
+
+/**
+ * @brief Incremental SHA-256.
+ */
+class Sha256 {
+ public:
+  Sha256();
+
+  void Update(const uint8_t* data, std::size_t n);
+
+  Digest Finalize();
+
+ private:
+  uint32_t mState[8];
+  uint8_t mBlock[64];
+  uint64_t mLength = 0;
+};
+
+/**
+ * @brief Incremental BLAKE3, with its extendable output.
+ */
+class Blake3 {
+ public:
+  Blake3();
+
+  void Update(const uint8_t* data, std::size_t n);
+
+  /**
+   * @brief The digest of the input so far.
+   *
+   * This is the first 32 bytes of the output, and more input can still be
+   * absorbed afterwards.
+   */
+  Digest Finalize() const;
+
+  /**
+   * @brief Read the extendable output.
+   *
+   * The first call ends the input, and later calls continue the same output
+   * stream.
+   *
+   * @param out where to write the output
+   * @param n the number of bytes to write
+   */
+  void Squeeze(uint8_t* out, std::size_t n);
+
+ private:
+  // the input of a compression whose output is either a chaining value or,
+  // for the root, a block of output.
+  struct Node {
+    uint32_t cv[8];
+    uint32_t block[16];
+    uint64_t counter;
+    uint32_t block_len;
+    uint32_t flags;
+  };
+
+  Node ChunkNode() const;
+  Node RootNode() const;
+  void AddChunk();
+
+  // chaining value and buffered block of the current chunk of 1 KiB.
+  uint32_t mCv[8];
+  uint8_t mBlock[64] = {0};
+  unsigned int mBlockLen = 0;
+  unsigned int mBlocksCompressed = 0;
+  uint64_t mChunkCounter = 0;
+  // chaining values of the complete subtrees to the left, enough for 2^64
+  // bytes of input.
+  uint32_t mStack[54][8];
+  unsigned int mStackLen = 0;
+
+  bool mSqueezing = false;
+  Node mRoot;
+  uint8_t mOutput[64];
+  unsigned int mOutputOffset = 0;
+};
+
 class Hash {
  public:
   static constexpr std::size_t DigestSize() { return 32; };
 
   Hash(){};
 
+  /**
+   * @brief Create a hash with a given backend.
+   * @param backend the hash function to use
+   */
+  explicit Hash(HashBackend backend) : mBackend(backend){};
+
+  /**
+   * @brief The hash function behind this hash.
+   */
+  HashBackend Backend() const { return mBackend; };
+
   Hash& Update(const uint8_t* data, std::size_t n);
   Hash& Update(const Point& point);
   Hash& Update(const Scalar& scalar);
 
+  /**
+   * @brief Absorb a list of ciphertexts.
+   *
+   * Gives the same result as absorbing U and V of every ciphertext in turn,
+   * but encodes the points in blocks on the stack and absorbs each block at
+   * once.
+   *
+   * @param ctxts the ciphertexts
+   */
+  Hash& Update(const std::vector<Ctxt>& ctxts);
+
   Digest Finalize();
 
+  /**
+   * @brief Absorb one message into each of several hashes.
+   *
+   * Gives the same result as hashes[i].Update(data + i * n, n) for every i,
+   * but the blocks that Keccak hashes fill are permuted together, up to
+   * eight at a time with KeccakF1600x8. This is faster for many small
+   * transcripts, such as one per proof in a batch.
+   *
+   * @param hashes the hashes
+   * @param count the number of hashes
+   * @param data count messages of n bytes, one after the other
+   * @param n the size of each message
+   */
+  static void UpdateMany(Hash* hashes, std::size_t count, const uint8_t* data,
+                         std::size_t n);
+
+  /**
+   * @brief Finalize several hashes, permuting their last blocks together.
+   * @param hashes the hashes
+   * @param count the number of hashes
+   * @param digests where to write the digest of each hash
+   */
+  static void FinalizeMany(Hash* hashes, std::size_t count, Digest* digests);
+
+  /**
+   * @brief Read output from the hash as an extendable output function.
+   *
+   * The first call pads the input like SHAKE256, which separates the output
+   * from that of Finalize. With SHA-256, block i of the output is the
+   * SHA-256 digest of the digest of the input and i as a big-endian 64-bit
+   * integer. With BLAKE3, the output is the extendable output of BLAKE3 from
+   * its second block of 64 bytes on, which does not contain the digest.
+   * Later calls continue the same output stream. No
+   * more input can be absorbed, and Finalize must not be called afterwards.
+   *
+   * @param out where to write the output
+   * @param n the number of bytes to write
+   */
+  void Squeeze(uint8_t* out, std::size_t n);
+
+  /**
+   * @brief Squeeze scalars from the hash.
+   *
+   * Every scalar is made from WideByteSize() bytes of output, so the scalars
+   * are uniform up to a negligible bias. One permutation yields two scalars.
+   *
+   * @param n the number of scalars
+   * @return the scalars.
+   */
+  std::vector<Scalar> SqueezeScalars(std::size_t n);
+
  private:
   static constexpr std::size_t kCapacity = 512 / (8 * sizeof(uint64_t));
   static constexpr std::size_t kStateSize = 25;
   static constexpr std::size_t kCutoff = kStateSize - (kCapacity & ~0x80000000);
+  // domain separation and first padding bit of SHA3 and SHAKE.
+  static constexpr uint64_t kSha3Suffix = 0x06;
+  static constexpr uint64_t kShakeSuffix = 0x1F;
+
+  void AbsorbWord(uint64_t word);
+  void Flush();
+  void Pad(uint64_t suffix);
+  Digest Output();
+  static void FlushMany(Hash* hashes, std::size_t count);
 
   uint64_t mState[kStateSize] = {0};
   uint8_t mStateBytes[kStateSize * 8] = {0};
   uint64_t mSaved = 0;
   unsigned int mByteIndex = 0;
   unsigned int mWordIndex = 0;
+  bool mSqueezing = false;
+  std::size_t mSqueezeOffset = 0;
+
+  HashBackend mBackend = HashBackend::kKeccak;
+  Sha256 mSha;
+  // input digest and current output block when squeezing SHA-256.
+  Digest mShaSeed;
+  Digest mShaOutput;
+  uint64_t mShaCounter = 0;
+  Blake3 mBlake;
 };
 
 Scalar ScalarFromHash(const Hash& hash);
 
+/**
+ * @brief Derive a challenge from each of several hashes.
+ *
+ * Equal to calling ScalarFromHash on every hash, with the final
+ * permutations done together (see Hash::FinalizeMany).
+ *
+ * @param hashes the hashes, which are left as they are
+ * @param n the number of hashes
+ * @param out where to write the n scalars
+ */
+void ScalarFromHashes(const Hash* hashes, std::size_t n, Scalar* out);
+
+/**
+ * @brief The Keccak-f[1600] permutation used by Hash.
+ *
+ * Uses AVX-512 when the CPU running the program has it, which is checked at
+ * run time, and KeccakF1600Scalar otherwise.
+ *
+ * @param state the 25 lanes of the state, permuted in place
+ */
+void KeccakF1600(uint64_t state[25]);
+
+/**
+ * @brief Keccak-f[1600] on 64-bit words.
+ *
+ * On targets without an and-not instruction, the rounds use lane
+ * complementing to save NOTs.
+ *
+ * @param state the 25 lanes of the state, permuted in place
+ */
+void KeccakF1600Scalar(uint64_t state[25]);
+
+/**
+ * @brief Keccak-f[1600] on four independent states in lockstep.
+ *
+ * The states are permuted as vectors of four lanes when the target has
+ * AVX2, and one after the other otherwise.
+ *
+ * @param states the states, permuted in place
+ */
+void KeccakF1600x4(uint64_t* const states[4]);
+
+/**
+ * @brief Keccak-f[1600] on eight independent states in lockstep.
+ *
+ * Uses vectors of eight lanes when the target has AVX-512, and two calls to
+ * KeccakF1600x4 otherwise.
+ *
+ * @param states the states, permuted in place
+ */
+void KeccakF1600x8(uint64_t* const states[8]);
+
+/**
+ * @brief Derive several challenges from the current state of a hash.
+ *
+ * Squeezes the scalars from a single copy of the hash, which is left as it
+ * is.
+ *
+ * @param hash the hash
+ * @param n the number of scalars
+ * @return the scalars.
+ */
+std::vector<Scalar> ScalarsFromHash(const Hash& hash, std::size_t n);
+
+/**
+ * @brief Digest of a list of ciphertexts under a label.
+ *
+ * A transcript can absorb the digest in place of the list, and refer to the
+ * same list later by absorbing the digest again, so that a long list is
+ * hashed only once.
+ *
+ * @param label the label of the list
+ * @param ctxts the ciphertexts
+ * @param backend the hash function to use
+ * @return the digest.
+ */
+Digest ListDigest(const std::string& label, const std::vector<Ctxt>& ctxts,
+                  HashBackend backend = HashBackend::kKeccak);
+
+/**
+ * @brief Digest of an encoded list of ciphertexts under a label.
+ *
+ * Equal to the digest of the decoded list.
+ *
+ * @param label the label of the list
+ * @param encoded 2*n points written by Point::Write
+ * @param n the number of ciphertexts
+ * @param backend the hash function to use
+ * @return the digest.
+ */
+Digest ListDigest(const std::string& label, const uint8_t* encoded,
+                  std::size_t n, HashBackend backend = HashBackend::kKeccak);
+
+/**
+ * @brief Digest of a list of ciphertexts under a label, computed as a tree.
+ *
+ * The list is split into leaves of 4096 ciphertexts that are hashed
+ * independently, on a thread pool if there is one, and the digest hashes
+ * the label, the length of the list and the leaf digests. This is a
+ * different function from ListDigest.
+ *
+ * @param label the label of the list
+ * @param ctxts the ciphertexts
+ * @param pool optional thread pool to hash the leaves on
+ * @param backend the hash function to use
+ * @return the digest.
+ */
+Digest TreeListDigest(const std::string& label, const std::vector<Ctxt>& ctxts,
+                      ThreadPool* pool = nullptr,
+                      HashBackend backend = HashBackend::kKeccak);
+
+/**
+ * @brief Tree digest of an encoded list of ciphertexts under a label.
+ *
+ * Equal to the tree digest of the decoded list.
+ *
+ * @param label the label of the list
+ * @param encoded 2*n points written by Point::Write
+ * @param n the number of ciphertexts
+ * @param pool optional thread pool to hash the leaves on
+ * @param backend the hash function to use
+ * @return the digest.
+ */
+Digest TreeListDigest(const std::string& label, const uint8_t* encoded,
+                      std::size_t n, ThreadPool* pool = nullptr,
+                      HashBackend backend = HashBackend::kKeccak);
+
 }  // namespace mh
 
 #endif  // SHF_HASH_H
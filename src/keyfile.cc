@@ -0,0 +1,206 @@
+#include "keyfile.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char kMagic[8] = {'S', 'H', 'F', 'K', 'E', 'Y', 0, 0};
+
+// points are checksummed in chunks of this size, which can be hashed in
+// parallel and keeps every call to relic's md_map below INT_MAX bytes.
+static constexpr std::size_t kChecksumChunk = 1 << 20;
+
+struct KeyFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint64_t point_size;
+  uint64_t count;
+  uint8_t layout[RLC_MD_LEN];
+  uint8_t checksum[RLC_MD_LEN];
+};
+
+// the points follow the header and are used in place.
+static_assert(sizeof(KeyFileHeader) % alignof(shf::Point) == 0,
+              "points in a key file would not be aligned");
+
+shf::Digest shf::PointLayoutFingerprint() {
+  uint8_t raw[8 + Point::RawSize()] = {0};
+  const uint64_t size = Point::RawSize();
+  std::memcpy(raw, &size, sizeof(size));
+  Point::Generator().WriteRaw(raw + 8);
+  Digest digest;
+  md_map(digest.data(), raw, sizeof(raw));
+  return digest;
+}
+
+static inline void Checksum(uint8_t* out, const uint8_t* data, std::size_t n,
+                            shf::ThreadPool* pool) {
+  const std::size_t chunks = (n + kChecksumChunk - 1) / kChecksumChunk;
+  std::vector<uint8_t> digests(chunks * RLC_MD_LEN);
+  shf::ParallelFor(pool, chunks, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const std::size_t offset = i * kChecksumChunk;
+      const std::size_t len = std::min(kChecksumChunk, n - offset);
+      md_map(digests.data() + i * RLC_MD_LEN, data + offset, len);
+    }
+  });
+  md_map(out, digests.data(), digests.size());
+}
+
+void shf::WriteKeyFile(const std::string& path, shf::KeyFileKind kind,
+                      const std::vector<const shf::Point*>& points) {
+  const std::size_t n = points.size();
+
+  // a reader only accepts affine points, so the others are normalized first.
+  std::vector<Point> normalized;
+  for (const Point* p : points)
+    if (!p->IsNormalized()) normalized.emplace_back(*p);
+  std::vector<Point*> todo;
+  for (Point& p : normalized) todo.emplace_back(&p);
+  Point::NormalizeBatch(todo);
+
+  std::vector<uint8_t> payload(n * shf::Point::RawSize());
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const Point& p = points[i]->IsNormalized() ? *points[i] : normalized[k++];
+    p.WriteRaw(payload.data() + i * shf::Point::RawSize());
+  }
+
+  KeyFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kKeyFileVersion;
+  header.kind = static_cast<uint32_t>(kind);
+  header.point_size = Point::RawSize();
+  header.count = n;
+  const Digest layout = PointLayoutFingerprint();
+  std::memcpy(header.layout, layout.data(), layout.size());
+  Checksum(header.checksum, payload.data(), payload.size(), nullptr);
+
+  // several threads or processes may write the same file at once.
+  static std::atomic<unsigned> counter{0};
+  const std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." +
+                          std::to_string(counter++);
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+  out.close();
+  if (!out || std::rename(tmp.c_str(), path.c_str())) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+// Checks the header of a mapped key file and returns it.
+static const KeyFileHeader& CheckHeader(const shf::MappedFile& file) {
+  if (file.Size() < sizeof(KeyFileHeader))
+    throw std::runtime_error("key file too small");
+
+  const auto& header = *reinterpret_cast<const KeyFileHeader*>(file.Data());
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)))
+    throw std::runtime_error("not a key file");
+  if (header.version != shf::kKeyFileVersion)
+    throw std::runtime_error("unsupported key file version");
+
+  const shf::Digest layout = shf::PointLayoutFingerprint();
+  if (header.point_size != shf::Point::RawSize() ||
+      std::memcmp(header.layout, layout.data(), layout.size()))
+    throw std::runtime_error("key file uses another point representation");
+
+  const std::size_t payload = file.Size() - sizeof(KeyFileHeader);
+  if (header.count != payload / shf::Point::RawSize() ||
+      payload % shf::Point::RawSize())
+    throw std::runtime_error("key file has the wrong size");
+  return header;
+}
+
+shf::KeyFilePoints shf::ReadKeyFile(const std::string& path,
+                                    shf::KeyFileKind kind,
+                                    shf::ThreadPool* pool,
+                                    const shf::Digest* expected_digest) {
+  auto file = std::make_shared<const MappedFile>(path);
+  const auto& header = CheckHeader(*file);
+  if (header.kind != static_cast<uint32_t>(kind))
+    throw std::runtime_error("wrong kind of key file");
+
+  // the checksum is computed over the mapping that is used afterwards, so
+  // comparing it with the expected digest covers exactly the points used.
+  const uint8_t* payload = file->Data() + sizeof(KeyFileHeader);
+  uint8_t checksum[RLC_MD_LEN];
+  Checksum(checksum, payload, file->Size() - sizeof(KeyFileHeader), pool);
+  if (std::memcmp(header.checksum, checksum, sizeof(checksum)))
+    throw std::runtime_error("key file checksum mismatch");
+  if (expected_digest &&
+      std::memcmp(expected_digest->data(), checksum, sizeof(checksum)))
+    throw std::runtime_error("key file does not match the expected digest");
+
+  const auto points = reinterpret_cast<const Point*>(payload);
+  std::atomic<bool> valid{true};
+  ParallelFor(pool, header.count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end && valid; ++i)
+      if (!points[i].IsValidRaw()) valid = false;
+  });
+  if (!valid) throw std::runtime_error("key file holds an invalid point");
+  return {std::move(file), points, header.count};
+}
+
+void shf::WriteCommitKey(const std::string& path, const shf::CommitKey& ck) {
+  // H comes first, followed by the generators in G.
+  std::vector<const Point*> points = {&ck.H.Base()};
+  for (const Point& G : ck.G) points.emplace_back(&G);
+  WriteKeyFile(path, KeyFileKind::kCommitKey, points);
+}
+
+// Checks that none of the points of a key is the point at infinity.
+static inline void CheckNoInfinity(const shf::KeyFilePoints& key,
+                                   shf::ThreadPool* pool) {
+  std::atomic<bool> found{false};
+  shf::ParallelFor(pool, key.count, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end && !found; ++i)
+      if (key.points[i].IsInfinity()) found = true;
+  });
+  if (found) throw std::runtime_error("key file holds the point at infinity");
+}
+
+shf::CommitKey shf::ReadCommitKey(const std::string& path,
+                                  shf::ThreadPool* pool,
+                                  const shf::Digest* expected_digest) {
+  const auto key =
+      ReadKeyFile(path, KeyFileKind::kCommitKey, pool, expected_digest);
+  if (key.count < 2)
+    throw std::runtime_error("commit key file without generators");
+  CheckNoInfinity(key, pool);
+
+  CommitKey ck;
+  ck.H = FixedBasePoint(key.points[0]);
+  ck.G = AffinePoints::View(key.file, key.points + 1, key.count - 1);
+  return ck;
+}
+
+void shf::WritePublicKey(const std::string& path, const shf::PublicKey& pk) {
+  WriteKeyFile(path, KeyFileKind::kPublicKey, {&pk});
+}
+
+shf::PublicKey shf::ReadPublicKey(const std::string& path,
+                                  const shf::Digest* expected_digest) {
+  const auto key =
+      ReadKeyFile(path, KeyFileKind::kPublicKey, nullptr, expected_digest);
+  if (key.count != 1)
+    throw std::runtime_error("public key file must hold one point");
+  CheckNoInfinity(key, nullptr);
+  return key.points[0];
+}
+
+shf::Digest shf::KeyFileDigest(const std::string& path) {
+  const MappedFile file(path);
+  const auto& header = CheckHeader(file);
+  Digest digest;
+  std::memcpy(digest.data(), header.checksum, digest.size());
+  return digest;
+}
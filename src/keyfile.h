@@ -0,0 +1,157 @@
+#ifndef SHF_KEYFILE_H
+#define SHF_KEYFILE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cipher.h"
+#include "commit.h"
+#include "hash.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+
+namespace shf {
+
+/**
+ * @brief Binary files for commitment keys and public keys.
+ *
+ * A key file is a fixed header followed by the points of the key in the
+ * in-memory representation of relic (see Point::WriteRaw). Reading a file
+ * maps it into memory and uses the points in place, so a large commitment key
+ * is available without decompressing or copying any point.
+ *
+ * The header holds a format version, a fingerprint of the point
+ * representation and a checksum of the points: the SHA-256 digest of the
+ * SHA-256 digests of every 1 MiB chunk of the points. A file written by a
+ * program with a different relic configuration, or a truncated or corrupted
+ * file, is rejected, and so is every point that is not a valid affine point
+ * (see Point::IsValidRaw).
+ *
+ * The checksum in the header protects against accidents only: whoever can
+ * write the file can also recompute it. A valid point is not necessarily the
+ * right one, so a key file from an untrusted location must be read with the
+ * trusted digest of the key as expected_digest. It is compared with the
+ * checksum of the mapped points themselves, so the file cannot change in
+ * between.
+ */
+
+/**
+ * @brief Current version of the key file format.
+ */
+static constexpr uint32_t kKeyFileVersion = 1;
+
+/**
+ * @brief What the points in a key file are.
+ */
+enum class KeyFileKind : uint32_t {
+  kCommitKey = 1,
+  kPublicKey = 2,
+  kFixedBaseTable = 3,
+};
+
+/**
+ * @brief Write points to a key file.
+ *
+ * The file is written under a temporary name and renamed, so a reader never
+ * sees a partial file.
+ *
+ * @param path the file to write
+ * @param kind what the points are
+ * @param points the points
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void WriteKeyFile(const std::string& path, KeyFileKind kind,
+                  const std::vector<const Point*>& points);
+
+/**
+ * @brief The points of a mapped key file.
+ */
+struct KeyFilePoints {
+  std::shared_ptr<const MappedFile> file;
+  const Point* points;
+  std::size_t count;
+};
+
+/**
+ * @brief Map a key file and check its header, checksum and points.
+ * @param path the file to read
+ * @param kind what the points should be
+ * @param pool optional thread pool to check the points on
+ * @param expected_digest optional trusted digest of the points, as returned
+ * by KeyFileDigest for a trusted copy of the file
+ * @return the points, which stay valid as long as the mapping is alive.
+ * @throws std::runtime_error if the file cannot be read, is invalid or does
+ * not match expected_digest.
+ */
+KeyFilePoints ReadKeyFile(const std::string& path, KeyFileKind kind,
+                          ThreadPool* pool = nullptr,
+                          const Digest* expected_digest = nullptr);
+
+/**
+ * @brief Fingerprint of the in-memory representation of points.
+ *
+ * Programs built against the same relic configuration have the same
+ * fingerprint.
+ */
+Digest PointLayoutFingerprint();
+
+/**
+ * @brief Write a commitment key to a file.
+ * @param path the file to write
+ * @param ck the key
+ */
+void WriteCommitKey(const std::string& path, const CommitKey& ck);
+
+/**
+ * @brief Read a commitment key written by WriteCommitKey.
+ *
+ * The generators of the key stay in the mapped file, which is unmapped when
+ * the last copy of the key is destroyed.
+ *
+ * @param path the file to read
+ * @param pool optional thread pool to check the points on
+ * @param expected_digest optional trusted digest of the key, see ReadKeyFile
+ * @return the key.
+ * @throws std::runtime_error if the file cannot be read, is invalid or does
+ * not match expected_digest.
+ */
+CommitKey ReadCommitKey(const std::string& path, ThreadPool* pool = nullptr,
+                        const Digest* expected_digest = nullptr);
+
+/**
+ * @brief Write a public key to a file.
+ * @param path the file to write
+ * @param pk the key
+ */
+void WritePublicKey(const std::string& path, const PublicKey& pk);
+
+/**
+ * @brief Read a public key written by WritePublicKey.
+ * @param path the file to read
+ * @param expected_digest optional trusted digest of the key, see ReadKeyFile
+ * @return the key.
+ * @throws std::runtime_error if the file cannot be read, is invalid or does
+ * not match expected_digest.
+ */
+PublicKey ReadPublicKey(const std::string& path,
+                        const Digest* expected_digest = nullptr);
+
+/**
+ * @brief The checksum stored in a key file.
+ *
+ * It is a digest of the points of the key, and can be published next to the
+ * key to authenticate copies of the file. Only the header is read, so the
+ * result is only trusted if the file is: take it from a trusted copy, and
+ * pass it as expected_digest when reading other copies.
+ *
+ * @param path the file to read
+ * @return the checksum.
+ * @throws std::runtime_error if the file cannot be read or has an invalid
+ * header.
+ */
+Digest KeyFileDigest(const std::string& path);
+
+}  // namespace shf
+
+#endif  // SHF_KEYFILE_H
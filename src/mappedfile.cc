@@ -0,0 +1,36 @@
+#include "mappedfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+shf::MappedFile::MappedFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("cannot open " + path);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("cannot stat " + path);
+  }
+  m_size = st.st_size;
+
+  // mmap does not accept empty mappings.
+  if (m_size) {
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("cannot map " + path);
+    }
+    m_data = static_cast<const uint8_t*>(data);
+  }
+  // the mapping stays valid after the descriptor is closed.
+  close(fd);
+}
+
+shf::MappedFile::~MappedFile() {
+  if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+}
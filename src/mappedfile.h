@@ -0,0 +1,38 @@
+#ifndef SHF_MAPPEDFILE_H
+#define SHF_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace shf {
+
+/**
+ * @brief A whole file mapped read-only into memory.
+ *
+ * Pages are shared with every other process that maps the same file.
+ */
+class MappedFile {
+ public:
+  /**
+   * @brief Map a file.
+   * @param path the file to map
+   * @throws std::runtime_error if the file cannot be opened or mapped.
+   */
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile& operator=(const MappedFile& other) = delete;
+
+  const uint8_t* Data() const { return m_data; };
+  std::size_t Size() const { return m_size; };
+
+ private:
+  const uint8_t* m_data = nullptr;
+  std::size_t m_size = 0;
+};
+
+}  // namespace shf
+
+#endif  // SHF_MAPPEDFILE_H
@@ -0,0 +1,222 @@
+#include "multiexp.h"
+
+#include <array>
+#include <stdexcept>
+
+using Limbs = std::array<uint64_t, 4>;
+
+static constexpr std::size_t kScalarBits = 256;
+
+// below this number of terms Straus beats Pippenger.
+static constexpr std::size_t kStrausThreshold = 32;
+static constexpr std::size_t kStrausWindow = 4;
+
+static constexpr std::size_t kMaxPippengerWindow = 16;
+
+// smaller inputs are not worth splitting over several threads.
+static constexpr std::size_t kParallelThreshold = 1024;
+
+// little-endian 64-bit limbs of a scalar in canonical form.
+static inline Limbs ToLimbs(const shf::Scalar& s) {
+  constexpr auto n = shf::Scalar::ByteSize();
+  uint8_t bytes[n];
+  s.Write(bytes);
+  Limbs limbs = {0};
+  for (std::size_t i = 0; i < n; ++i)
+    limbs[i / 8] |= (uint64_t)bytes[n - 1 - i] << (8 * (i % 8));
+  return limbs;
+}
+
+static inline std::size_t GetWindow(const Limbs& k, const std::size_t offset,
+                                    const std::size_t width) {
+  const std::size_t idx = offset / 64;
+  const std::size_t shift = offset % 64;
+  uint64_t w = k[idx] >> shift;
+  if (shift + width > 64 && idx + 1 < k.size()) w |= k[idx + 1] << (64 - shift);
+  return w & ((1ULL << width) - 1);
+}
+
+// pick the window size c minimizing ceil(bits/c) * (n + 2^c) additions.
+static inline std::size_t PippengerWindow(const std::size_t n) {
+  std::size_t best = 1;
+  std::size_t best_cost = ~(std::size_t)0;
+  for (std::size_t c = 1; c <= kMaxPippengerWindow; ++c) {
+    const std::size_t cost = ((kScalarBits + c - 1) / c) * (n + (1ULL << c));
+    if (cost < best_cost) {
+      best = c;
+      best_cost = cost;
+    }
+  }
+  return best;
+}
+
+static void Straus(ep_st* r, const std::vector<Limbs>& ks,
+                   const std::vector<const ep_st*>& ps) {
+  const std::size_t n = ks.size();
+  const std::size_t tsize = (1 << kStrausWindow) - 1;
+
+  // table[i*tsize + j] = (j + 1) * ps[i]
+  std::vector<ep_st> table(n * tsize);
+  for (std::size_t i = 0; i < n; ++i) {
+    ep_st* t = &table[i * tsize];
+    ep_copy(t, ps[i]);
+    for (std::size_t j = 1; j < tsize; ++j) ep_add(t + j, t + j - 1, ps[i]);
+  }
+  // every entry is used a few times, so mixed additions pay for this.
+  ep_t* t = reinterpret_cast<ep_t*>(table.data());
+  ep_norm_sim(t, t, table.size());
+
+  ep_set_infty(r);
+  for (std::size_t w = kScalarBits / kStrausWindow; w-- > 0;) {
+    for (std::size_t j = 0; j < kStrausWindow; ++j) ep_dbl(r, r);
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t d = GetWindow(ks[i], w * kStrausWindow, kStrausWindow);
+      if (d) ep_add(r, r, &table[i * tsize + d - 1]);
+    }
+  }
+}
+
+static void Pippenger(ep_st* r, const std::vector<Limbs>& ks,
+                      const std::vector<const ep_st*>& ps) {
+  const std::size_t n = ks.size();
+  const std::size_t c = PippengerWindow(n);
+  const std::size_t nbuckets = (1 << c) - 1;
+
+  std::vector<ep_st> buckets(nbuckets);
+  ep_t sum, acc;
+
+  ep_set_infty(r);
+  for (std::size_t w = (kScalarBits + c - 1) / c; w-- > 0;) {
+    for (std::size_t j = 0; j < c; ++j) ep_dbl(r, r);
+
+    for (auto& b : buckets) ep_set_infty(&b);
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t d = GetWindow(ks[i], w * c, c);
+      if (d) ep_add(&buckets[d - 1], &buckets[d - 1], ps[i]);
+    }
+
+    // sum_j (j + 1) * buckets[j] with two additions per bucket.
+    ep_set_infty(sum);
+    ep_set_infty(acc);
+    for (std::size_t j = nbuckets; j-- > 0;) {
+      ep_add(sum, sum, &buckets[j]);
+      ep_add(acc, acc, sum);
+    }
+    ep_add(r, r, acc);
+  }
+}
+
+shf::Point shf::MultiExp(const std::vector<shf::Scalar>& scalars,
+                         const std::vector<const shf::Point*>& points,
+                         shf::ThreadPool* pool) {
+  const std::size_t n = scalars.size();
+  if (points.size() < n)
+    throw std::invalid_argument("not enough points for multi exponentiation");
+
+  // r = sum_{begin <= i < end} scalars[i]*points[i]
+  auto partial = [&](std::size_t begin, std::size_t end, Point& r) {
+    std::vector<Limbs> ks;
+    std::vector<const ep_st*> ps;
+    ks.reserve(end - begin);
+    ps.reserve(end - begin);
+    for (std::size_t i = begin; i < end; ++i) {
+      if (scalars[i].IsZero() || points[i]->IsInfinity()) continue;
+      ks.emplace_back(ToLimbs(scalars[i]));
+      ps.emplace_back(points[i]->m_internal);
+    }
+
+    if (ks.empty()) return;
+    if (ks.size() < kStrausThreshold) {
+      Straus(r.m_internal, ks, ps);
+      return;
+    }
+
+    // Pippenger adds every point into a bucket once per window, so it pays
+    // to bring the points to affine coordinates first.
+    std::vector<std::size_t> idx;
+    for (std::size_t i = 0; i < ps.size(); ++i)
+      if (!ps[i]->norm) idx.emplace_back(i);
+    std::vector<Point> affine(idx.size());
+    std::vector<Point*> affine_ptrs;
+    affine_ptrs.reserve(idx.size());
+    for (std::size_t j = 0; j < idx.size(); ++j) {
+      ec_copy(affine[j].m_internal, ps[idx[j]]);
+      affine_ptrs.emplace_back(&affine[j]);
+    }
+    Point::NormalizeBatch(affine_ptrs);
+    for (std::size_t j = 0; j < idx.size(); ++j)
+      ps[idx[j]] = affine[j].m_internal;
+
+    Pippenger(r.m_internal, ks, ps);
+  };
+
+  // every thread computes the multi exponentiation of a slice of the terms.
+  const std::size_t slices =
+      n < kParallelThreshold ? 1 : ParallelBlocks(pool, n);
+  std::vector<Point> rs(slices);
+  ParallelFor(pool, slices, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t s = begin; s < end; ++s)
+      partial(n * s / slices, n * (s + 1) / slices, rs[s]);
+  });
+
+  Point r = rs[0];
+  for (std::size_t s = 1; s < slices; ++s) r += rs[s];
+  return r;
+}
+
+shf::Point shf::MultiExp(const std::vector<shf::Scalar>& scalars,
+                         const std::vector<shf::Point>& points,
+                         shf::ThreadPool* pool) {
+  const std::size_t n = scalars.size();
+  if (points.size() < n)
+    throw std::invalid_argument("not enough points for multi exponentiation");
+
+  std::vector<const Point*> ptrs;
+  ptrs.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) ptrs.emplace_back(&points[i]);
+  return MultiExp(scalars, ptrs, pool);
+}
+
+shf::Point shf::MultiExp(const std::vector<shf::Scalar>& scalars,
+                         const shf::AffinePoints& points,
+                         shf::ThreadPool* pool) {
+  const std::size_t n = scalars.size();
+  if (points.Size() < n)
+    throw std::invalid_argument("not enough points for multi exponentiation");
+
+  std::vector<const Point*> ptrs;
+  ptrs.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) ptrs.emplace_back(&points[i]);
+  return MultiExp(scalars, ptrs, pool);
+}
+
+void shf::MultiExpBatch::Add(const shf::Scalar& scalar,
+                             const shf::Point& base) {
+  const auto it = m_index.find(&base);
+  if (it != m_index.end()) {
+    m_scalars[it->second] += scalar;
+    return;
+  }
+  m_index.emplace(&base, m_points.size());
+  m_scalars.emplace_back(scalar);
+  m_points.emplace_back(&base);
+}
+
+void shf::MultiExpBatch::Add(const shf::MultiExpBatch& other) {
+  for (std::size_t i = 0; i < other.Size(); ++i)
+    Add(other.m_scalars[i], *other.m_points[i]);
+}
+
+std::vector<shf::Scalar> shf::MultiExpBatch::Weights(std::size_t n) {
+  if (!m_seeded) {
+    uint8_t seed[Scalar::ByteSize()];
+    Scalar::CreateRandom().Write(seed);
+    m_weights.Update(seed, sizeof(seed));
+    m_seeded = true;
+  }
+  return m_weights.SqueezeScalars(n);
+}
+
+shf::Point shf::MultiExpBatch::Evaluate(shf::ThreadPool* pool) const {
+  return MultiExp(m_scalars, m_points, pool);
+}
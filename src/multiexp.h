@@ -0,0 +1,108 @@
+#ifndef SHF_MULTIEXP_H
+#define SHF_MULTIEXP_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "curve.h"
+#include "hash.h"
+#include "threadpool.h"
+
+namespace shf {
+
+/**
+ * @brief Compute a multi-scalar multiplication.
+ *
+ * Small inputs are handled with Straus' interleaved window method, larger
+ * inputs with Pippenger's bucket method using a window size chosen from the
+ * number of terms.
+ *
+ * @param scalars the scalars
+ * @param points the points. Must contain at least scalars.size() elements
+ * @param pool optional thread pool to spread the terms over
+ * @return sum_i scalars[i]*points[i].
+ */
+Point MultiExp(const std::vector<Scalar>& scalars,
+               const std::vector<Point>& points, ThreadPool* pool = nullptr);
+
+/**
+ * @brief Compute a multi-scalar multiplication over points that are not
+ * stored contiguously.
+ * @param scalars the scalars
+ * @param points pointers to the points. Must contain at least scalars.size()
+ * elements
+ * @param pool optional thread pool to spread the terms over
+ * @return sum_i scalars[i]*(*points[i]).
+ */
+Point MultiExp(const std::vector<Scalar>& scalars,
+               const std::vector<const Point*>& points,
+               ThreadPool* pool = nullptr);
+
+/**
+ * @brief Compute a multi-scalar multiplication over affine points.
+ * @param scalars the scalars
+ * @param points the points. Must contain at least scalars.size() elements
+ * @param pool optional thread pool to spread the terms over
+ * @return sum_i scalars[i]*points[i].
+ */
+Point MultiExp(const std::vector<Scalar>& scalars, const AffinePoints& points,
+               ThreadPool* pool = nullptr);
+
+/**
+ * @brief A sum of scalar multiplications evaluated with a single MultiExp.
+ *
+ * Terms are merged by the address of their base, so a point that shows up in
+ * many terms, such as a generator of a commitment key, is multiplied only
+ * once by the sum of its scalars. Bases are not copied and must outlive the
+ * batch.
+ */
+class MultiExpBatch {
+ public:
+  /**
+   * @brief Add a term to the sum.
+   * @param scalar the scalar
+   * @param base the point to multiply
+   */
+  void Add(const Scalar& scalar, const Point& base);
+
+  /**
+   * @brief Add all terms of another batch to this one.
+   * @param other the batch to add
+   */
+  void Add(const MultiExpBatch& other);
+
+  /**
+   * @brief Draw random weights to combine equations added to the batch.
+   *
+   * The first call draws one random seed, and every weight of the batch is
+   * squeezed from a hash of it, so the random generator and its lock are
+   * used once per batch.
+   *
+   * @param n the number of weights
+   * @return the weights.
+   */
+  std::vector<Scalar> Weights(std::size_t n);
+
+  /**
+   * @brief Number of distinct bases in the sum.
+   */
+  std::size_t Size() const { return m_points.size(); };
+
+  /**
+   * @brief Compute the sum.
+   * @param pool optional thread pool to spread the terms over
+   * @return sum_i scalars[i]*bases[i].
+   */
+  Point Evaluate(ThreadPool* pool = nullptr) const;
+
+ private:
+  std::unordered_map<const Point*, std::size_t> m_index;
+  std::vector<Scalar> m_scalars;
+  std::vector<const Point*> m_points;
+  Hash m_weights;
+  bool m_seeded = false;
+};
+
+}  // namespace shf
+
+#endif  // SHF_MULTIEXP_H
@@ -0,0 +1,118 @@
+#include "precompute.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "keyfile.h"
+
+// generators of a cached commit key that are derived again when it is loaded.
+static constexpr std::size_t kCommitKeySamples = 64;
+
+static inline std::string ToHex(const uint8_t* data, std::size_t n) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(2 * n);
+  for (std::size_t i = 0; i < n; ++i) {
+    hex += kDigits[data[i] >> 4];
+    hex += kDigits[data[i] & 0xf];
+  }
+  return hex;
+}
+
+bool shf::PrecomputeCache::IsPrivate() const {
+  struct stat st;
+  return stat(m_directory.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+         st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+std::string shf::PrecomputeCache::Path(
+    const std::string& kind, const std::vector<uint8_t>& inputs) const {
+  // files from builds with another point representation get other names.
+  const Digest layout = PointLayoutFingerprint();
+  std::vector<uint8_t> msg(kind.begin(), kind.end());
+  msg.emplace_back(0);
+  msg.insert(msg.end(), layout.begin(), layout.end());
+  msg.insert(msg.end(), inputs.begin(), inputs.end());
+  Digest digest;
+  md_map(digest.data(), msg.data(), msg.size());
+  return m_directory + "/" + kind + "-" + ToHex(digest.data(), digest.size()) +
+         ".shf";
+}
+
+std::string shf::PrecomputeCache::FixedBasePath(const shf::Point& base) const {
+  std::vector<uint8_t> encoded(Point::ByteSize());
+  base.Write(encoded.data());
+  return Path("fixed-base", encoded);
+}
+
+void shf::PrecomputeCache::Store(const shf::FixedBasePoint& point) const {
+  // the base comes first, followed by its table.
+  std::vector<const Point*> points = {&point.Base()};
+  for (std::size_t i = 0; i < FixedBasePoint::TableSize(); ++i)
+    points.emplace_back(point.Table() + i);
+  try {
+    WriteKeyFile(FixedBasePath(point.Base()), KeyFileKind::kFixedBaseTable,
+                 points);
+  } catch (const std::runtime_error&) {
+    // the cache is best effort.
+  }
+}
+
+shf::FixedBasePoint shf::PrecomputeCache::FixedBase(
+    const shf::Point& base) const {
+  // a table is cheap to compute but not to check, so the cached one is
+  // compared with a fresh one and only used to share its memory.
+  const FixedBasePoint point(base);
+  if (!IsPrivate()) return point;
+  try {
+    const auto table =
+        ReadKeyFile(FixedBasePath(base), KeyFileKind::kFixedBaseTable);
+    if (table.count == FixedBasePoint::TableSize() + 1 &&
+        table.points[0] == base &&
+        std::equal(point.Table(), point.Table() + FixedBasePoint::TableSize(),
+                   table.points + 1))
+      return FixedBasePoint::View(base, table.file, table.points + 1);
+  } catch (const std::runtime_error&) {
+    // missing or invalid, so write it again.
+  }
+
+  Store(point);
+  return point;
+}
+
+shf::CommitKey shf::PrecomputeCache::CommitKeyFromSeed(
+    std::size_t size, const uint8_t* seed, std::size_t seed_size,
+    shf::ThreadPool* pool) const {
+  std::vector<uint8_t> inputs;
+  for (std::size_t i = 0; i < 8; ++i) inputs.emplace_back(size >> (8 * i));
+  inputs.insert(inputs.end(), seed, seed + seed_size);
+  const std::string path = Path("commit-key", inputs);
+  if (!IsPrivate()) return CreateCommitKey(size, seed, seed_size, pool);
+
+  try {
+    // the layout of a commit key file is H followed by G.
+    const auto key = ReadKeyFile(path, KeyFileKind::kCommitKey, pool);
+    if (key.count == size + 1) {
+      CommitKey ck;
+      ck.H = FixedBase(key.points[0]);
+      ck.G = AffinePoints::View(key.file, key.points + 1, size);
+      if (SpotCheckCommitKey(ck, seed, seed_size, kCommitKeySamples, pool))
+        return ck;
+    }
+  } catch (const std::runtime_error&) {
+    // missing or invalid, so compute it again.
+  }
+
+  const CommitKey ck = CreateCommitKey(size, seed, seed_size, pool);
+  try {
+    WriteCommitKey(path, ck);
+  } catch (const std::runtime_error&) {
+    // the cache is best effort.
+  }
+  Store(ck.H);
+  return ck;
+}
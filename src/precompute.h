@@ -0,0 +1,76 @@
+#ifndef SHF_PRECOMPUTE_H
+#define SHF_PRECOMPUTE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "commit.h"
+#include "curve.h"
+#include "threadpool.h"
+
+namespace shf {
+
+/**
+ * @brief A directory of precomputed tables shared between processes.
+ *
+ * Tables are stored as key files (see keyfile.h) named by a digest of what
+ * they were computed from, and are memory mapped read-only when loaded, so
+ * processes on the same machine share a single copy of every table. A
+ * missing or invalid file is recomputed and written back. Writing is best
+ * effort: a cache that cannot be written only costs the precomputation.
+ *
+ * The directory must be trusted: whoever can write to it can plant a
+ * commitment key with known discrete logs, and a verifier using that key
+ * accepts forged proofs. It must therefore be owned by the user running the
+ * process and must not be writable by anyone else; a directory that is not
+ * is ignored, and everything is computed without the cache. On top of that,
+ * every loaded point is validated (see Point::IsValidRaw), a fixed-base table
+ * is compared with a freshly computed one, and H and a random sample of the
+ * generators of a commitment key are derived again from the seed.
+ */
+class PrecomputeCache {
+ public:
+  /**
+   * @brief Use a directory as cache.
+   * @param directory the directory. Must exist, be owned by the current user
+   * and not be writable by group or others
+   */
+  explicit PrecomputeCache(std::string directory)
+      : m_directory(std::move(directory)){};
+
+  /**
+   * @brief Get a fixed base point with its table taken from the cache.
+   * @param base the base
+   * @return a fixed base point for base.
+   */
+  FixedBasePoint FixedBase(const Point& base) const;
+
+  /**
+   * @brief Get the commitment key derived from a seed, see CreateCommitKey.
+   *
+   * Both the key and the table of H are taken from the cache.
+   *
+   * @param size the number of generators in G
+   * @param seed the seed
+   * @param seed_size the size of the seed in bytes
+   * @param pool optional thread pool to spread the work over
+   * @return a commitment key.
+   */
+  CommitKey CommitKeyFromSeed(std::size_t size, const uint8_t* seed,
+                              std::size_t seed_size,
+                              ThreadPool* pool = nullptr) const;
+
+ private:
+  bool IsPrivate() const;
+  std::string Path(const std::string& kind,
+                   const std::vector<uint8_t>& inputs) const;
+  std::string FixedBasePath(const Point& base) const;
+  void Store(const FixedBasePoint& point) const;
+
+  std::string m_directory;
+};
+
+}  // namespace shf
+
+#endif  // SHF_PRECOMPUTE_H
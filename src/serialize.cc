@@ -0,0 +1,255 @@
+#include "serialize.h"
+
+#include <stdexcept>
+#include <string>
+
+static constexpr std::size_t kLengthSize = 8;
+
+static inline void WriteLength(uint8_t* dest, std::size_t n) {
+  const uint64_t v = n;
+  for (std::size_t i = 0; i < kLengthSize; ++i)
+    dest[i] = (uint8_t)(v >> (8 * (kLengthSize - 1 - i)));
+}
+
+static inline uint64_t ReadLength(const uint8_t* bytes) {
+  uint64_t v = 0;
+  for (std::size_t i = 0; i < kLengthSize; ++i) v = (v << 8) | bytes[i];
+  return v;
+}
+
+void shf::WriteCiphertexts(const std::vector<shf::Ctxt>& ctxts, uint8_t* dest,
+                           shf::ThreadPool* pool,
+                           shf::Point::Encoding encoding) {
+  const std::size_t pb = Point::ByteSize(encoding);
+  // writing a point normalizes it, which is worth spreading out. The
+  // compressed encoding lets each chunk share the inversions via WriteBatch.
+  ParallelFor(pool, ctxts.size(), [&](std::size_t begin, std::size_t end) {
+    if (encoding == Point::Encoding::kCompressed) {
+      std::vector<const Point*> points;
+      points.reserve(2 * (end - begin));
+      for (std::size_t i = begin; i < end; ++i) {
+        points.push_back(&ctxts[i].U);
+        points.push_back(&ctxts[i].V);
+      }
+      Point::WriteBatch(points.data(), points.size(), dest + 2 * begin * pb);
+      return;
+    }
+    for (std::size_t i = begin; i < end; ++i) {
+      ctxts[i].U.Write(dest + 2 * i * pb, encoding);
+      ctxts[i].V.Write(dest + (2 * i + 1) * pb, encoding);
+    }
+  });
+}
+
+std::vector<shf::Ctxt> shf::ReadCiphertexts(const uint8_t* bytes,
+                                            std::size_t n,
+                                            shf::ThreadPool* pool,
+                                            shf::Point::Encoding encoding) {
+  std::vector<Point> points(2 * n);
+  const auto errors =
+      Point::ReadBatch(bytes, points.size(), points.data(), encoding, pool);
+  if (!errors.empty())
+    throw std::invalid_argument("invalid point in ciphertext " +
+                                std::to_string(errors[0] / 2));
+
+  std::vector<Ctxt> ctxts(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    ctxts[i].U.Swap(points[2 * i]);
+    ctxts[i].V.Swap(points[2 * i + 1]);
+  }
+  return ctxts;
+}
+
+std::size_t shf::SerializedSize(const shf::ShuffleP& proof) {
+  const std::size_t pb = Point::ByteSize();
+  const std::size_t sb = Scalar::ByteSize();
+  const auto& pp = proof.product_proof;
+  const auto& mp = proof.multiexp_proof;
+  return 2 + kLengthSize + 2 * proof.permuted.size() * pb + 2 * pb + 3 * pb +
+         2 * kLengthSize + (pp.as.size() + pp.bs.size() + 2) * sb + 4 * pb +
+         kLengthSize + (mp.a.size() + 4) * sb;
+}
+
+void shf::Serialize(const shf::ShuffleP& proof, std::vector<uint8_t>& buffer,
+                    shf::ThreadPool* pool) {
+  const std::size_t pb = Point::ByteSize();
+  const std::size_t sb = Scalar::ByteSize();
+  const std::size_t start = buffer.size();
+  buffer.resize(start + SerializedSize(proof));
+  uint8_t* p = buffer.data() + start;
+
+  *p++ = kProofFormatVersion;
+  *p++ = static_cast<uint8_t>(proof.hash_backend);
+
+  const std::size_t n = proof.permuted.size();
+  WriteLength(p, n);
+  p += kLengthSize;
+  WriteCiphertexts(proof.permuted, p, pool);
+  p += 2 * n * pb;
+
+  const auto write_point = [&](const Point& P) {
+    P.Write(p);
+    p += pb;
+  };
+  const auto write_scalars = [&](const std::vector<Scalar>& ss) {
+    WriteLength(p, ss.size());
+    p += kLengthSize;
+    for (const auto& s : ss) {
+      s.Write(p);
+      p += sb;
+    }
+  };
+  const auto write_scalar = [&](const Scalar& s) {
+    s.Write(p);
+    p += sb;
+  };
+
+  write_point(proof.Ca);
+  write_point(proof.Cb);
+
+  const auto& pp = proof.product_proof;
+  write_point(pp.C0);
+  write_point(pp.C1);
+  write_point(pp.C2);
+  write_scalars(pp.as);
+  write_scalars(pp.bs);
+  write_scalar(pp.r);
+  write_scalar(pp.s);
+
+  const auto& mp = proof.multiexp_proof;
+  write_point(mp.C0);
+  write_point(mp.C1);
+  write_point(mp.E.U);
+  write_point(mp.E.V);
+  write_scalars(mp.a);
+  write_scalar(mp.r);
+  write_scalar(mp.b);
+  write_scalar(mp.s);
+  write_scalar(mp.t);
+}
+
+// reads the length of a list of elements of a given size at offset, checks
+// that the list fits in the encoding, and advances offset past the list.
+static inline std::size_t ReadList(const uint8_t* data, std::size_t size,
+                                   std::size_t& offset,
+                                   std::size_t element_size) {
+  if (size - offset < kLengthSize)
+    throw std::invalid_argument("truncated proof");
+  const uint64_t n = ReadLength(data + offset);
+  offset += kLengthSize;
+  if (n > (size - offset) / element_size)
+    throw std::invalid_argument("truncated proof");
+  offset += n * element_size;
+  return n;
+}
+
+shf::ShuffleProofView::ShuffleProofView(const uint8_t* data, std::size_t size)
+    : m_data(data) {
+  const std::size_t pb = Point::ByteSize();
+  const std::size_t sb = Scalar::ByteSize();
+
+  if (!size || data[0] != kProofFormatVersion)
+    throw std::invalid_argument("unsupported proof version");
+  if (size < 2 || data[1] > static_cast<uint8_t>(HashBackend::kBlake3))
+    throw std::invalid_argument("unsupported hash backend");
+  m_backend = static_cast<HashBackend>(data[1]);
+  std::size_t offset = 2;
+
+  const auto skip = [&](std::size_t n) {
+    if (size - offset < n) throw std::invalid_argument("truncated proof");
+    offset += n;
+  };
+
+  m_permuted = offset + kLengthSize;
+  m_n = ReadList(data, size, offset, 2 * pb);
+
+  m_ca = offset;
+  skip(2 * pb);
+
+  m_product = offset;
+  skip(3 * pb);
+  m_as = offset + kLengthSize;
+  m_product_size = ReadList(data, size, offset, sb);
+  m_bs = offset + kLengthSize;
+  if (ReadList(data, size, offset, sb) != m_product_size)
+    throw std::invalid_argument("invalid product proof");
+  m_product_tail = offset;
+  skip(2 * sb);
+
+  m_multiexp = offset;
+  skip(4 * pb);
+  m_a = offset + kLengthSize;
+  m_multiexp_size = ReadList(data, size, offset, sb);
+  m_multiexp_tail = offset;
+  skip(4 * sb);
+
+  if (offset != size) throw std::invalid_argument("trailing bytes in proof");
+}
+
+shf::Ctxt shf::ShuffleProofView::Permuted(std::size_t i) const {
+  const std::size_t offset = m_permuted + 2 * i * Point::ByteSize();
+  return {ReadPoint(offset), ReadPoint(offset + Point::ByteSize())};
+}
+
+shf::Scalar shf::ShuffleProofView::ProductA(std::size_t i) const {
+  return ReadScalar(m_as + i * Scalar::ByteSize());
+}
+
+shf::Scalar shf::ShuffleProofView::ProductB(std::size_t i) const {
+  return ReadScalar(m_bs + i * Scalar::ByteSize());
+}
+
+shf::Scalar shf::ShuffleProofView::MultiExpA(std::size_t i) const {
+  return ReadScalar(m_a + i * Scalar::ByteSize());
+}
+
+shf::ProductP shf::ShuffleProofView::ProductProof(shf::ThreadPool* pool) const {
+  const std::size_t pb = Point::ByteSize();
+  const std::size_t sb = Scalar::ByteSize();
+  ProductP proof;
+  proof.C0 = ReadPoint(m_product);
+  proof.C1 = ReadPoint(m_product + pb);
+  proof.C2 = ReadPoint(m_product + 2 * pb);
+  proof.as.resize(m_product_size);
+  proof.bs.resize(m_product_size);
+  ParallelFor(pool, m_product_size, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      proof.as[i] = ProductA(i);
+      proof.bs[i] = ProductB(i);
+    }
+  });
+  proof.r = ReadScalar(m_product_tail);
+  proof.s = ReadScalar(m_product_tail + sb);
+  return proof;
+}
+
+shf::MultiExpP shf::ShuffleProofView::MultiExpProof(
+    shf::ThreadPool* pool) const {
+  const std::size_t pb = Point::ByteSize();
+  const std::size_t sb = Scalar::ByteSize();
+  MultiExpP proof;
+  proof.C0 = ReadPoint(m_multiexp);
+  proof.C1 = ReadPoint(m_multiexp + pb);
+  proof.E.U = ReadPoint(m_multiexp + 2 * pb);
+  proof.E.V = ReadPoint(m_multiexp + 3 * pb);
+  proof.a.resize(m_multiexp_size);
+  ParallelFor(pool, m_multiexp_size, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) proof.a[i] = MultiExpA(i);
+  });
+  proof.r = ReadScalar(m_multiexp_tail);
+  proof.b = ReadScalar(m_multiexp_tail + sb);
+  proof.s = ReadScalar(m_multiexp_tail + 2 * sb);
+  proof.t = ReadScalar(m_multiexp_tail + 3 * sb);
+  return proof;
+}
+
+shf::ShuffleP shf::ShuffleProofView::ToProof(shf::ThreadPool* pool) const {
+  ShuffleP proof;
+  proof.permuted = ReadCiphertexts(PermutedBytes(), m_n, pool);
+  proof.Ca = Ca();
+  proof.Cb = Cb();
+  proof.product_proof = ProductProof(pool);
+  proof.multiexp_proof = MultiExpProof(pool);
+  proof.hash_backend = m_backend;
+  return proof;
+}
@@ -0,0 +1,219 @@
+#ifndef SHF_SERIALIZE_H
+#define SHF_SERIALIZE_H
+
+#include <vector>
+
+#include "cipher.h"
+#include "curve.h"
+#include "shuffler.h"
+#include "threadpool.h"
+#include "zkp.h"
+
+namespace shf {
+
+/**
+ * @brief Binary encoding of shuffle proofs.
+ *
+ * A proof is encoded as a version byte and the hash backend of its
+ * transcript, followed by its other fields in the order they appear in
+ * ShuffleP. Points and scalars use Point::Write and Scalar::Write, and every
+ * list is prefixed with its length as a big-endian 64-bit integer:
+ *
+ *   version, hash backend
+ *   n, permuted[0].U, permuted[0].V, ..., permuted[n-1].V
+ *   Ca, Cb
+ *   C0, C1, C2, |as|, as, |bs|, bs, r, s        (product proof)
+ *   C0, C1, E.U, E.V, |a|, a, r, b, s, t        (multi-exponent proof)
+ *
+ * All fields have a fixed size, so the encoding of a proof is determined by
+ * its list lengths and any field can be located without parsing the others.
+ */
+
+/**
+ * @brief Current version of the proof encoding.
+ *
+ * Version 2 added the hash backend.
+ */
+static constexpr uint8_t kProofFormatVersion = 2;
+
+/**
+ * @brief Encode a list of ciphertexts, as in the permuted list of a proof.
+ *
+ * Shuffler::VerifyShuffle takes encoded ciphertexts in the compressed
+ * encoding only. The uncompressed one is faster to decode, but only suits
+ * ciphertexts that are decoded with ReadCiphertexts.
+ *
+ * @param ctxts the ciphertexts
+ * @param dest where to write 2*ctxts.size()*Point::ByteSize(encoding) bytes
+ * @param pool optional thread pool to encode points on
+ * @param encoding the encoding of the points
+ */
+void WriteCiphertexts(
+    const std::vector<Ctxt>& ctxts, uint8_t* dest, ThreadPool* pool = nullptr,
+    Point::Encoding encoding = Point::Encoding::kCompressed);
+
+/**
+ * @brief Decode a list of ciphertexts written by WriteCiphertexts.
+ * @param bytes the encoding
+ * @param n the number of ciphertexts
+ * @param pool optional thread pool to decode points on
+ * @param encoding the encoding of the points
+ * @return the ciphertexts.
+ * @throws std::invalid_argument if a point is invalid.
+ */
+std::vector<Ctxt> ReadCiphertexts(
+    const uint8_t* bytes, std::size_t n, ThreadPool* pool = nullptr,
+    Point::Encoding encoding = Point::Encoding::kCompressed);
+
+/**
+ * @brief Size of the encoding of a proof.
+ * @param proof the proof
+ * @return the number of bytes written by Serialize.
+ */
+std::size_t SerializedSize(const ShuffleP& proof);
+
+/**
+ * @brief Encode a proof.
+ * @param proof the proof
+ * @param buffer the buffer to append the encoding to
+ * @param pool optional thread pool to encode points on
+ */
+void Serialize(const ShuffleP& proof, std::vector<uint8_t>& buffer,
+               ThreadPool* pool = nullptr);
+
+/**
+ * @brief A read-only view of an encoded shuffle proof.
+ *
+ * The view checks the structure of the encoding when it is created, and
+ * decodes fields only when they are accessed. Decoding throws
+ * std::invalid_argument if a point is invalid or a scalar is not reduced
+ * modulo the group order, so a proof has a single encoding. It does not copy
+ * the encoding, which must outlive the view.
+ */
+class ShuffleProofView {
+ public:
+  /**
+   * @brief Create a view of an encoded proof.
+   * @param data the encoding
+   * @param size the size of the encoding in bytes
+   * @throws std::invalid_argument if the encoding is malformed.
+   */
+  ShuffleProofView(const uint8_t* data, std::size_t size);
+
+  /**
+   * @brief Number of permuted ciphertexts.
+   */
+  std::size_t Size() const { return m_n; };
+
+  /**
+   * @brief The hash backend of the transcript of the proof.
+   */
+  HashBackend Backend() const { return m_backend; };
+
+  /**
+   * @brief The encoding of the permuted ciphertexts.
+   * @return 2*Size() encoded points, U and V of each ciphertext in turn.
+   */
+  const uint8_t* PermutedBytes() const { return m_data + m_permuted; };
+
+  /**
+   * @brief Decode a permuted ciphertext.
+   * @param i the index of the ciphertext. Must be less than Size()
+   */
+  Ctxt Permuted(std::size_t i) const;
+
+  /**
+   * @brief The encoding of the commitment to the permutation.
+   */
+  const uint8_t* CaBytes() const { return m_data + m_ca; };
+
+  /**
+   * @brief The encoding of the commitment to the exponentiated permutation.
+   */
+  const uint8_t* CbBytes() const { return CaBytes() + Point::ByteSize(); };
+
+  /**
+   * @brief Decode the commitment to the permutation.
+   */
+  Point Ca() const { return Point::Read(CaBytes()); };
+
+  /**
+   * @brief Decode the commitment to the exponentiated permutation.
+   */
+  Point Cb() const { return Point::Read(CbBytes()); };
+
+  /**
+   * @brief Number of elements in each list of the product proof.
+   */
+  std::size_t ProductSize() const { return m_product_size; };
+
+  /**
+   * @brief Decode an element of the list as of the product proof.
+   * @param i the index. Must be less than ProductSize()
+   */
+  Scalar ProductA(std::size_t i) const;
+
+  /**
+   * @brief Decode an element of the list bs of the product proof.
+   * @param i the index. Must be less than ProductSize()
+   */
+  Scalar ProductB(std::size_t i) const;
+
+  /**
+   * @brief Number of elements in the list a of the multi-exponent proof.
+   */
+  std::size_t MultiExpSize() const { return m_multiexp_size; };
+
+  /**
+   * @brief Decode an element of the list a of the multi-exponent proof.
+   * @param i the index. Must be less than MultiExpSize()
+   */
+  Scalar MultiExpA(std::size_t i) const;
+
+  /**
+   * @brief Decode the product proof.
+   * @param pool optional thread pool to decode on
+   */
+  ProductP ProductProof(ThreadPool* pool = nullptr) const;
+
+  /**
+   * @brief Decode the multi-exponent proof.
+   * @param pool optional thread pool to decode on
+   */
+  MultiExpP MultiExpProof(ThreadPool* pool = nullptr) const;
+
+  /**
+   * @brief Decode the whole proof.
+   * @param pool optional thread pool to decode on
+   */
+  ShuffleP ToProof(ThreadPool* pool = nullptr) const;
+
+ private:
+  Point ReadPoint(std::size_t offset) const {
+    return Point::Read(m_data + offset);
+  };
+
+  Scalar ReadScalar(std::size_t offset) const {
+    return Scalar::ReadCanonical(m_data + offset);
+  };
+
+  const uint8_t* m_data;
+  HashBackend m_backend;
+  std::size_t m_n;
+  std::size_t m_product_size;
+  std::size_t m_multiexp_size;
+  // offsets of the groups of fields, and of the lists.
+  std::size_t m_permuted;
+  std::size_t m_ca;
+  std::size_t m_product;
+  std::size_t m_as;
+  std::size_t m_bs;
+  std::size_t m_product_tail;
+  std::size_t m_multiexp;
+  std::size_t m_a;
+  std::size_t m_multiexp_tail;
+};
+
+}  // namespace shf
+
+#endif  // SHF_SERIALIZE_H
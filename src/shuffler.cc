@@ -3,6 +3,8 @@
 #include <iostream>
 #include <numeric>
 
+#include "serialize.h"
+
 shf::Permutation shf::CreatePermutation(std::size_t size, shf::Prg& prg) {
   if (!size) return Permutation();
 
@@ -22,61 +24,134 @@ shf::Permutation shf::CreatePermutation(std::size_t size, shf::Prg& prg) {
 }
 
 static inline std::vector<shf::Scalar> PermutationAsScalars(
-    const shf::Permutation p) {
-  std::vector<shf::Scalar> s;
+    const shf::Permutation& p, shf::ThreadPool* pool) {
   const std::size_t n = p.size();
-  s.reserve(n);
-  for (std::size_t i = 0; i < n; ++i)
-    s.emplace_back(shf::Scalar::CreateFromInt(p[i]));
+  std::vector<shf::Scalar> s(n);
+  shf::ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+      s[i] = shf::Scalar::CreateFromInt(p[i]);
+  });
   return s;
 }
 
+// Compute x^e by square-and-multiply.
+static inline shf::Scalar Pow(const shf::Scalar& x, std::size_t e) {
+  shf::Scalar r = shf::Scalar::CreateFromInt(1);
+  shf::Scalar b = x;
+  for (; e; e >>= 1) {
+    if (e & 1) r *= b;
+    b *= b;
+  }
+  return r;
+}
+
 // Compute {x, x^2, x^3, ..., x^n}
 static inline std::vector<shf::Scalar> ExpSuccessive(const shf::Scalar& x,
-                                                    const std::size_t n) {
-  std::vector<shf::Scalar> values;
-  values.reserve(n);
-  values.emplace_back(x);
-  for (std::size_t i = 1; i < n; ++i) values.emplace_back(values[i - 1] * x);
+                                                    const std::size_t n,
+                                                    shf::ThreadPool* pool) {
+  std::vector<shf::Scalar> values(n);
+  // every chunk starts from its own power of x.
+  shf::ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    values[begin] = Pow(x, begin + 1);
+    for (std::size_t i = begin + 1; i < end; ++i)
+      values[i] = values[i - 1] * x;
+  });
   return values;
 }
 
-#define TYPED_VECTOR(_typ, _name, _size) \
-  std::vector<_typ> _name;               \
-  _name.reserve(_size);
-
-#define SCALAR_VECTOR(_name, _size) TYPED_VECTOR(shf::Scalar, _name, _size)
-
-static inline shf::Ctxt Randomize(const shf::PublicKey& pk, const shf::Ctxt& E,
-                                 const shf::Scalar& r) {
+static inline shf::Ctxt Randomize(const shf::FixedBasePoint& pk,
+                                 const shf::Ctxt& E, const shf::Scalar& r) {
   return shf::Add(shf::Encrypt(pk, shf::Point(), r), E);
 }
 
 static inline std::vector<shf::Ctxt> Randomize(
-    const shf::PublicKey& pk, const std::vector<shf::Ctxt>& Es,
-    const std::vector<shf::Scalar>& rs) {
+    const shf::FixedBasePoint& pk, const std::vector<shf::Ctxt>& Es,
+    const std::vector<shf::Scalar>& rs, shf::ThreadPool* pool) {
   const std::size_t n = Es.size();
-  TYPED_VECTOR(shf::Ctxt, randomized, n);
-  const shf::Point one = shf::Point();
-  for (std::size_t i = 0; i < n; ++i) {
-    randomized.emplace_back(Randomize(pk, Es[i], rs[i]));
-  }
+  std::vector<shf::Ctxt> randomized(n);
+  shf::ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+      randomized[i] = Randomize(pk, Es[i], rs[i]);
+  });
+  shf::Normalize(randomized, pool);
   return randomized;
 }
 
 static inline shf::Scalar NegateInnerProd(const std::vector<shf::Scalar>& a,
-                                         const std::vector<shf::Scalar>& b) {
-  shf::Scalar d;
-  for (std::size_t i = 0; i < a.size(); i++) d += a[i] * b[i];
+                                         const std::vector<shf::Scalar>& b,
+                                         shf::ThreadPool* pool) {
+  const shf::Scalar d = shf::ParallelReduce(
+      pool, a.size(), shf::Scalar(),
+      [&](std::size_t begin, std::size_t end) {
+        shf::Scalar s;
+        for (std::size_t i = begin; i < end; i++) s += a[i] * b[i];
+        return s;
+      },
+      [](const shf::Scalar& x, const shf::Scalar& y) { return x + y; });
   return -d;
 }
 
+static const char kInputLabel[] = "shuffle input";
+static const char kPermutedLabel[] = "shuffle output";
+
+// the transcript absorbs the digests of the input and permuted ciphertexts
+// in place of the lists. The multi-exponent proof refers to the permuted
+// ciphertexts by the same digest, so every list is hashed once.
+struct ShuffleDigests {
+  shf::ListHashing mode;
+  shf::Digest ctxts;
+  shf::Digest permuted;
+};
+
+static inline shf::Digest DigestList(shf::ListHashing mode,
+                                     shf::HashBackend backend,
+                                     const std::string& label,
+                                     const std::vector<shf::Ctxt>& Es,
+                                     shf::ThreadPool* pool) {
+  if (mode == shf::ListHashing::kTree)
+    return shf::TreeListDigest(label, Es, pool, backend);
+  return shf::ListDigest(label, Es, backend);
+}
+
+static inline shf::Digest DigestList(shf::ListHashing mode,
+                                     shf::HashBackend backend,
+                                     const std::string& label,
+                                     const uint8_t* Es, std::size_t n,
+                                     shf::ThreadPool* pool) {
+  if (mode == shf::ListHashing::kTree)
+    return shf::TreeListDigest(label, Es, n, pool, backend);
+  return shf::ListDigest(label, Es, n, backend);
+}
+
+// both lists are hashed at the same time, with the hash function of the
+// transcript.
+static inline ShuffleDigests DigestLists(shf::ListHashing mode,
+                                         shf::HashBackend backend,
+                                         const std::vector<shf::Ctxt>& Es,
+                                         const std::vector<shf::Ctxt>& pEs,
+                                         shf::ThreadPool* pool) {
+  ShuffleDigests digests;
+  digests.mode = mode;
+  shf::ParallelFor(pool, 2, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      if (i == 0)
+        digests.ctxts = DigestList(mode, backend, kInputLabel, Es, pool);
+      else
+        digests.permuted =
+            DigestList(mode, backend, kPermutedLabel, pEs, pool);
+    }
+  });
+  return digests;
+}
+
 static inline shf::Scalar ShuffleChallenge1(shf::Hash& hash,
-                                           const std::vector<shf::Ctxt>& Es,
-                                           const std::vector<shf::Ctxt>& pEs,
+                                           const ShuffleDigests& digests,
                                            const shf::Point& C) {
-  for (const shf::Ctxt& E : Es) hash.Update(E.U).Update(E.V);
-  for (const shf::Ctxt& E : pEs) hash.Update(E.U).Update(E.V);
+  const uint8_t header[2] = {shf::kShuffleTranscriptVersion,
+                             static_cast<uint8_t>(digests.mode)};
+  hash.Update(header, sizeof(header));
+  hash.Update(digests.ctxts.data(), digests.ctxts.size());
+  hash.Update(digests.permuted.data(), digests.permuted.size());
   hash.Update(C);
   return shf::ScalarFromHash(hash);
 }
@@ -88,96 +163,245 @@ static inline shf::Scalar ShuffleChallenge1(shf::Hash& hash,
       _name.emplace_back(shf::Scalar::CreateRandom()); \
   } while (0)
 
-static inline shf::Scalar ShuffleChallenge2(shf::Hash& hash, const shf::Scalar& c,
-                                           const shf::Point& C) {
+// y and z are squeezed from the same state.
+static inline std::vector<shf::Scalar> ShuffleChallenge2(shf::Hash& hash,
+                                                        const shf::Scalar& c,
+                                                        const shf::Point& C) {
   hash.Update(c).Update(C);
-  return shf::ScalarFromHash(hash);
-}
-
-static inline shf::Scalar ShuffleChallenge3(shf::Hash& hash,
-                                           const shf::Scalar& c) {
-  hash.Update(c);
-  return shf::ScalarFromHash(hash);
+  return shf::ScalarsFromHash(hash, 2);
 }
 
 shf::ShuffleP shf::Shuffler::Shuffle(const std::vector<shf::Ctxt>& Es,
                                    shf::Hash& hash) {
   const std::size_t n = Es.size();
 
+  // All randomness is drawn in the same order with or without a thread pool,
+  // so the proof only depends on the state of the random generators.
+
   // permute and randomize ciphertexts
   const Permutation p = CreatePermutation(n, m_prg);
   std::vector<Scalar> rho;
   RANDOM_SCALAR_VECTOR(rho, n);
-  const std::vector<Ctxt> pEs = Randomize(m_pk, Permute(Es, p), rho);
+  const std::vector<Ctxt> pEs = Randomize(m_pk, Permute(Es, p), rho, m_pool);
 
   // Ca = commit(ck ; pi(1) ... pi(n) ; r)
-  const std::vector<Scalar> a = PermutationAsScalars(p);
-  const CommitmentAndRandomness Ca = Commit(m_ck, a);
+  const std::vector<Scalar> a = PermutationAsScalars(p, m_pool);
+  const CommitmentAndRandomness Ca = Commit(m_ck, a, m_pool);
 
-  const Scalar x = ShuffleChallenge1(hash, Es, pEs, Ca.C);
+  const ShuffleDigests digests =
+      DigestLists(m_list_hashing, hash.Backend(), Es, pEs, m_pool);
+  const Scalar x = ShuffleChallenge1(hash, digests, Ca.C);
 
   // Cb = commit(ck ; pi(1)*c0 ... pi(n)*c0 ; s);
-  const std::vector<Scalar> xexp = ExpSuccessive(x, n);
+  const std::vector<Scalar> xexp = ExpSuccessive(x, n, m_pool);
   const std::vector<Scalar> b = Permute(xexp, p);
-  const CommitmentAndRandomness Cb = Commit(m_ck, b);
-
-  const Scalar y = ShuffleChallenge2(hash, x, Cb.C);
-  const Scalar z = ShuffleChallenge3(hash, y);
-
-  SCALAR_VECTOR(dz, n);
-  dz.emplace_back(y * a[0] + b[0] - z);
-  Scalar prod = dz[0];
-  for (std::size_t i = 1; i < n; ++i) {
-    dz.emplace_back(y * a[i] + b[i] - z);
-    prod *= dz[i];
-  }
+  const CommitmentAndRandomness Cb = Commit(m_ck, b, m_pool);
+
+  const std::vector<Scalar> yz = ShuffleChallenge2(hash, x, Cb.C);
+  const Scalar& y = yz[0];
+  const Scalar& z = yz[1];
+
+  std::vector<Scalar> dz(n);
+  const Scalar prod = ParallelReduce(
+      m_pool, n, Scalar::CreateFromInt(1),
+      [&](std::size_t begin, std::size_t end) {
+        Scalar s = Scalar::CreateFromInt(1);
+        for (std::size_t i = begin; i < end; ++i) {
+          dz[i] = y * a[i] + b[i] - z;
+          s *= dz[i];
+        }
+        return s;
+      },
+      [](const Scalar& u, const Scalar& v) { return u * v; });
   const Scalar t = y * Ca.r + Cb.r;
-  const Point CdCz = Commit(m_ck, t, dz);
+  const Point CdCz = Commit(m_ck, t, dz, m_pool);
   // product proof that commit(ck ; d - z ; t) is a commitment of dz.
-  const ProductP proof0 = CreateProof(m_ck, hash, {CdCz, prod}, dz, t);
+  const ProductP proof0 =
+      CreateProof(m_ck, hash, {CdCz, prod}, dz, t, m_pool);
 
-  const Scalar rr = NegateInnerProd(rho, b);
-  const Ctxt Ex = Add(Encrypt(m_pk, Point(), rr), Dot(b, pEs));
+  const Scalar rr = NegateInnerProd(rho, b, m_pool);
+  const Ctxt Ex = Add(Encrypt(m_pk, Point(), rr), Dot(b, pEs, m_pool));
   const MultiExpP proof1 =
-      CreateProof(m_ck, m_pk, hash, {pEs, Ex, Cb.C}, b, Cb.r, rr);
+      CreateProof(m_ck, m_pk.Base(), hash, {pEs, Ex, Cb.C}, b, Cb.r, rr,
+                  m_pool, &digests.permuted);
 
-  return {pEs, Ca.C, Cb.C, proof0, proof1};
+  return {pEs, Ca.C, Cb.C, proof0, proof1, hash.Backend()};
 }
 
-static inline shf::Point CommitConstantNoRandomness(const shf::CommitKey& ck,
-                                                   const shf::Scalar& s) {
-  shf::Point Cz;
-  for (const shf::Point& Gi : ck.G) Cz += Gi * s;
-  return Cz;
+// Computes sum_i G[i]. A commitment to n copies of s without randomness is
+// s*(sum_i G[i]), so this turns it into a single multiplication.
+static inline shf::Point SumCommitKey(const shf::CommitKey& ck,
+                                      shf::ThreadPool* pool) {
+  return shf::ParallelReduce(
+      pool, ck.Size(), shf::Point(),
+      [&](std::size_t begin, std::size_t end) {
+        shf::Point sum;
+        for (std::size_t i = begin; i < end; ++i) sum += ck.G[i];
+        return sum;
+      },
+      [](const shf::Point& a, const shf::Point& b) { return a + b; });
+}
+
+// prod = (0*y + x - z) * (1*y + x^2 - z) * ... * ((n-1)*y + x^n - z)
+static inline shf::Scalar ShuffleProduct(const std::vector<shf::Scalar>& xexp,
+                                         const shf::Scalar& y,
+                                         const shf::Scalar& z,
+                                         shf::ThreadPool* pool) {
+  return shf::ParallelReduce(
+      pool, xexp.size(), shf::Scalar::CreateFromInt(1),
+      [&](std::size_t begin, std::size_t end) {
+        shf::Scalar s = shf::Scalar::CreateFromInt(1);
+        for (std::size_t i = begin; i < end; ++i)
+          s *= shf::Scalar::CreateFromInt(i) * y + xexp[i] - z;
+        return s;
+      },
+      [](const shf::Scalar& u, const shf::Scalar& v) { return u * v; });
+}
+
+// statements of the two sub-proofs of a shuffle proof. A batch refers to
+// them, so they must stay in place while the batch is alive. The
+// multi-exponent statement leaves Es empty: the batch refers to the permuted
+// ciphertexts of the proof instead.
+struct ShuffleStatements {
+  shf::ProductS product;
+  shf::MultiExpS multiexp;
+};
+
+static bool AddShuffleToBatch(shf::MultiExpBatch& batch,
+                              const shf::CommitKey& ck,
+                              const shf::FixedBasePoint& pk,
+                              const shf::Point& sum_G,
+                              const std::vector<shf::Ctxt>& ctxts,
+                              const shf::ShuffleP& proof,
+                              const ShuffleDigests& digests, shf::Hash& hash,
+                              ShuffleStatements& statements,
+                              shf::ThreadPool* pool) {
+  const std::size_t n = ctxts.size();
+  if (n < 2 || proof.permuted.size() != n ||
+      proof.hash_backend != hash.Backend())
+    return false;
+
+  const shf::Scalar x = ShuffleChallenge1(hash, digests, proof.Ca);
+  const std::vector<shf::Scalar> yz = ShuffleChallenge2(hash, x, proof.Cb);
+  const shf::Scalar& y = yz[0];
+  const shf::Scalar& z = yz[1];
+
+  const std::vector<shf::Scalar> xexp = ExpSuccessive(x, n, pool);
+  const shf::Point CdCz =
+      shf::Point::MulSim(y, proof.Ca, -z, sum_G) + proof.Cb;
+  statements.product = {CdCz, ShuffleProduct(xexp, y, z, pool)};
+  statements.multiexp = {{}, shf::Dot(xexp, ctxts, pool), proof.Cb};
+
+  return shf::AddToBatch(batch, ck, hash, statements.product,
+                         proof.product_proof) &&
+         shf::AddToBatch(batch, ck, pk.Base(), hash, statements.multiexp,
+                         proof.multiexp_proof, &digests.permuted,
+                         &proof.permuted);
 }
 
 bool shf::Shuffler::VerifyShuffle(const std::vector<shf::Ctxt>& ctxts,
                                  const shf::ShuffleP& proof, shf::Hash& hash) {
-  const Scalar x = ShuffleChallenge1(hash, ctxts, proof.permuted, proof.Ca);
-  const Scalar y = ShuffleChallenge2(hash, x, proof.Cb);
-  const Scalar z = ShuffleChallenge3(hash, y);
-
-  const Point Cz = CommitConstantNoRandomness(m_ck, -z);
-  const Point Cd = y * proof.Ca + proof.Cb;
-  const Point CdCz = Cd + Cz;
+  // all equations of both sub-proofs are checked with a single random linear
+  // combination, so every G[i] is multiplied once.
+  const Point sum_G = SumCommitKey(m_ck, m_pool);
+  const ShuffleDigests digests =
+      DigestLists(m_list_hashing, hash.Backend(), ctxts, proof.permuted,
+                  m_pool);
+  ShuffleStatements statements;
+  MultiExpBatch batch;
+  return AddShuffleToBatch(batch, m_ck, m_pk, sum_G, ctxts, proof, digests,
+                           hash, statements, m_pool) &&
+         batch.Evaluate(m_pool).IsInfinity();
+}
 
-  const std::size_t n = ctxts.size();
-  SCALAR_VECTOR(xexp, n);
-  xexp.emplace_back(x);
-  Scalar prod = x - z;
-  for (std::size_t i = 1; i < n; ++i) {
-    xexp.emplace_back(xexp[i - 1] * x);
-    prod *= Scalar::CreateFromInt(i) * y + xexp[i] - z;
+bool shf::Shuffler::VerifyShuffle(const uint8_t* ctxts, std::size_t n,
+                                   const shf::ShuffleProofView& proof,
+                                   shf::Hash& hash) {
+  if (proof.Size() != n) return false;
+
+  // the received ciphertexts are hashed as they are, so the decoded points
+  // are only needed for the group equations. Hashing both lists and decoding
+  // both lists are independent, so all four run at the same time.
+  const HashBackend backend = hash.Backend();
+  ShuffleDigests digests;
+  digests.mode = m_list_hashing;
+  std::vector<Ctxt> Es;
+  ShuffleP decoded;
+  try {
+    ParallelFor(m_pool, 4, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) {
+        if (i == 0)
+          digests.ctxts = DigestList(m_list_hashing, backend, kInputLabel,
+                                     ctxts, n, m_pool);
+        else if (i == 1)
+          digests.permuted = DigestList(m_list_hashing, backend,
+                                        kPermutedLabel, proof.PermutedBytes(),
+                                        n, m_pool);
+        else if (i == 2)
+          Es = ReadCiphertexts(ctxts, n, m_pool);
+        else
+          decoded = proof.ToProof(m_pool);
+      }
+    });
+  } catch (const std::invalid_argument&) {
+    return false;
   }
 
-  const ProductP proof0 = proof.product_proof;
-  const bool check0 = VerifyProof(m_ck, hash, {CdCz, prod}, proof0);
-
-  const std::vector<Ctxt> pEs = proof.permuted;
-  const Ctxt Ex = Dot(xexp, ctxts);
-  const MultiExpP proof1 = proof.multiexp_proof;
-  const bool check1 =
-      VerifyProof(m_ck, m_pk, hash, {pEs, Ex, proof.Cb}, proof1);
+  const Point sum_G = SumCommitKey(m_ck, m_pool);
+  ShuffleStatements statements;
+  MultiExpBatch batch;
+  return AddShuffleToBatch(batch, m_ck, m_pk, sum_G, Es, decoded, digests,
+                           hash, statements, m_pool) &&
+         batch.Evaluate(m_pool).IsInfinity();
+}
 
-  return check0 && check1;
+bool shf::Shuffler::BatchVerifyShuffles(
+    const std::vector<std::vector<shf::Ctxt>>& ctxt_lists,
+    const std::vector<shf::ShuffleP>& proofs, std::vector<shf::Hash>& hashes,
+    std::vector<std::size_t>* invalid) {
+  const std::size_t m = proofs.size();
+  if (ctxt_lists.size() != m || hashes.size() != m)
+    throw std::invalid_argument("need a ciphertext list and a hash per proof");
+
+  const Point sum_G = SumCommitKey(m_ck, m_pool);
+
+  // every proof gets its own batch, so that they can be checked one by one
+  // if the combined check fails.
+  std::vector<ShuffleStatements> statements(m);
+  std::vector<MultiExpBatch> batches(m);
+  std::vector<char> wellformed(m);
+  ParallelFor(m_pool, m, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const ShuffleDigests digests =
+          DigestLists(m_list_hashing, hashes[i].Backend(), ctxt_lists[i],
+                      proofs[i].permuted, m_pool);
+      wellformed[i] = AddShuffleToBatch(batches[i], m_ck, m_pk, sum_G,
+                                        ctxt_lists[i], proofs[i], digests,
+                                        hashes[i], statements[i], m_pool);
+    }
+  });
+
+  bool all_wellformed = true;
+  MultiExpBatch batch;
+  for (std::size_t i = 0; i < m; ++i) {
+    if (wellformed[i])
+      batch.Add(batches[i]);
+    else
+      all_wellformed = false;
+  }
+  if (all_wellformed && batch.Evaluate(m_pool).IsInfinity()) {
+    if (invalid) invalid->clear();
+    return true;
+  }
+  if (!invalid) return false;
+
+  std::vector<char> valid(m);
+  ParallelFor(m_pool, m, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+      valid[i] = wellformed[i] && batches[i].Evaluate().IsInfinity();
+  });
+  invalid->clear();
+  for (std::size_t i = 0; i < m; ++i)
+    if (!valid[i]) invalid->emplace_back(i);
+  return false;
 }
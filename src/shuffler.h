@@ -8,10 +8,13 @@
 #include "commit.h"
 #include "curve.h"
 #include "prg.h"
+#include "threadpool.h"
 #include "zkp.h"
 
 namespace shf {
 
+class ShuffleProofView;
+
 /**
  * @brief A permutation is a list of integers.
  */
@@ -42,12 +45,37 @@ std::vector<T> Permute(const std::vector<T>& things, const Permutation& perm) {
   return permuted;
 }
 
+/**
+ * @brief Version of the Fiat-Shamir transcript of shuffle proofs.
+ *
+ * It is absorbed first, so a proof only verifies with the version it was
+ * created with. Version 2 absorbs every ciphertext list once, version 3
+ * squeezes the challenges y and z from one state, and version 4 absorbs how
+ * the ciphertext lists are hashed.
+ */
+static constexpr uint8_t kShuffleTranscriptVersion = 4;
+
+/**
+ * @brief How the ciphertext lists of a shuffle are hashed into its transcript.
+ *
+ * kSequential hashes each list with ListDigest. kTree hashes it with
+ * TreeListDigest, whose leaves are hashed in parallel, which is faster for
+ * very large lists on a thread pool. The mode is part of the transcript, so
+ * the prover and the verifier must use the same one.
+ */
+enum class ListHashing : uint8_t {
+  kSequential = 0,
+  kTree = 1,
+};
+
 struct ShuffleP {
   std::vector<Ctxt> permuted;
   Point Ca;
   Point Cb;
   ProductP product_proof;
   MultiExpP multiexp_proof;
+  // the backend of the transcript the proof was created with.
+  HashBackend hash_backend = HashBackend::kKeccak;
 };
 
 class Shuffler {
@@ -55,6 +83,41 @@ class Shuffler {
   Shuffler(const PublicKey& pk, const CommitKey& ck, Prg& prg)
       : m_pk(pk), m_ck(ck), m_prg(prg){};
 
+  /**
+   * @brief Create a shuffler that spreads its work over a thread pool.
+   *
+   * Both proving and verifying use the pool. Proofs are the same as the ones
+   * created without a pool, given the same state of the random generators.
+   *
+   * @param pk the public key
+   * @param ck the commitment key
+   * @param prg the random generator for permutations
+   * @param pool the thread pool. Must outlive the shuffler
+   */
+  Shuffler(const PublicKey& pk, const CommitKey& ck, Prg& prg, ThreadPool& pool)
+      : m_pk(pk), m_ck(ck), m_prg(prg), m_pool(&pool){};
+
+  /**
+   * @brief Create a shuffler for a public key with a precomputed table, for
+   * example one taken from a PrecomputeCache.
+   * @param pk the public key
+   * @param ck the commitment key
+   * @param prg the random generator for permutations
+   * @param pool optional thread pool. Must outlive the shuffler
+   */
+  Shuffler(const FixedBasePoint& pk, const CommitKey& ck, Prg& prg,
+           ThreadPool* pool = nullptr)
+      : m_pk(pk), m_ck(ck), m_prg(prg), m_pool(pool){};
+
+  /**
+   * @brief Set how ciphertext lists are hashed into the transcript.
+   *
+   * The default is ListHashing::kSequential.
+   *
+   * @param mode the mode used by proving and verifying
+   */
+  void SetListHashing(ListHashing mode) { m_list_hashing = mode; };
+
   /**
    * @brief Shuffle a set of ciphertexts and return a proof of correctness.
    * @param ctxts ciphertexts to shuffle
@@ -65,6 +128,10 @@ class Shuffler {
 
   /**
    * @brief Verify a shuffle.
+   *
+   * The equations of both sub-proofs are combined with random weights and
+   * checked with one multi-exponentiation.
+   *
    * @param ctxts the ciphertexts that were shuffled
    * @param proof the proof to verify
    * @param hash a hash function object
@@ -73,10 +140,54 @@ class Shuffler {
   bool VerifyShuffle(const std::vector<Ctxt>& ctxts, const ShuffleP& proof,
                      Hash& hash);
 
+  /**
+   * @brief Verify a shuffle from its encoding.
+   *
+   * The ciphertext lists are hashed as they were received, and are only
+   * decoded for the group equations. This gives the same result as
+   * decoding everything and calling VerifyShuffle on the decoded values. A
+   * point that is not on the curve makes the proof invalid.
+   *
+   * The ciphertexts must be in the compressed encoding, the default of
+   * WriteCiphertexts. They are hashed as they are, and the transcript of the
+   * prover hashes compressed points, so uncompressed ciphertexts never
+   * verify.
+   *
+   * @param ctxts the ciphertexts that were shuffled, as written by
+   * WriteCiphertexts with Point::Encoding::kCompressed
+   * @param n the number of ciphertexts
+   * @param proof the encoded proof to verify
+   * @param hash a hash function object
+   * @return true if the shuffle was correct and false otherwise.
+   */
+  bool VerifyShuffle(const uint8_t* ctxts, std::size_t n,
+                     const ShuffleProofView& proof, Hash& hash);
+
+  /**
+   * @brief Verify many shuffles at once.
+   *
+   * The group equations of all proofs are combined with random weights and
+   * checked with a single multi-exponentiation. If that check fails, every
+   * proof is checked on its own to find the invalid ones.
+   *
+   * @param ctxt_lists the ciphertexts that were shuffled, one list per proof
+   * @param proofs the proofs to verify
+   * @param hashes a hash function object per proof
+   * @param invalid if not null, set to the indices of the invalid proofs
+   * @return true if all shuffles were correct and false otherwise.
+   */
+  bool BatchVerifyShuffles(const std::vector<std::vector<Ctxt>>& ctxt_lists,
+                           const std::vector<ShuffleP>& proofs,
+                           std::vector<Hash>& hashes,
+                           std::vector<std::size_t>* invalid = nullptr);
+
  private:
-  PublicKey m_pk;
+  // public key with a precomputed table for rerandomization.
+  FixedBasePoint m_pk;
   CommitKey m_ck;
   Prg m_prg;
+  ThreadPool* m_pool = nullptr;
+  ListHashing m_list_hashing = ListHashing::kSequential;
 };
 
 }  // namespace mh
@@ -0,0 +1,133 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <exception>
+
+// chunks per thread handed out by ParallelFor. More chunks than threads lets
+// idle workers steal work from slow ones.
+static constexpr std::size_t kChunksPerThread = 4;
+
+struct shf::ThreadPool::Job {
+  std::atomic<std::size_t> pending{0};
+  std::mutex mutex;
+  std::exception_ptr error;
+};
+
+// the pool and queue index of the current thread, if it is a worker.
+static thread_local const shf::ThreadPool* t_pool = nullptr;
+static thread_local std::size_t t_queue = 0;
+
+shf::ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < threads; ++i)
+    m_queues.emplace_back(std::make_unique<Queue>());
+
+  m_workers.reserve(threads - 1);
+  for (std::size_t i = 0; i < threads - 1; ++i)
+    m_workers.emplace_back([this, i] { WorkerLoop(i); });
+}
+
+shf::ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  for (auto& w : m_workers) w.join();
+}
+
+std::size_t shf::ThreadPool::OwnQueue() const {
+  return t_pool == this ? t_queue : m_queues.size() - 1;
+}
+
+void shf::ThreadPool::ParallelFor(std::size_t n, const RangeFunction& fn) {
+  if (!n) return;
+  if (m_workers.empty()) {
+    fn(0, n);
+    return;
+  }
+
+  const std::size_t chunks = std::min(n, kChunksPerThread * Size());
+  const std::size_t self = OwnQueue();
+  Job job;
+  job.pending = chunks;
+
+  // count the tasks before they become visible, so that m_queued never drops
+  // below the number of queued tasks.
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queued += chunks;
+  }
+  for (std::size_t c = 0; c < chunks; ++c) {
+    Queue& q = *m_queues[(self + c) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    q.tasks.push_back({&fn, n * c / chunks, n * (c + 1) / chunks, &job});
+  }
+  m_cv.notify_all();
+
+  // help out until every chunk of this loop is done. This may run tasks of
+  // other loops as well.
+  while (job.pending.load() > 0)
+    if (!TryRunTask(self)) std::this_thread::yield();
+
+  if (job.error) std::rethrow_exception(job.error);
+}
+
+bool shf::ThreadPool::TryRunTask(std::size_t self) {
+  Task task;
+  bool found = false;
+
+  for (std::size_t i = 0; i < m_queues.size() && !found; ++i) {
+    Queue& q = *m_queues[(self + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) continue;
+    // own queue is used as a stack, other queues are stolen from the front.
+    if (i == 0) {
+      task = q.tasks.back();
+      q.tasks.pop_back();
+    } else {
+      task = q.tasks.front();
+      q.tasks.pop_front();
+    }
+    found = true;
+  }
+
+  if (!found) return false;
+  m_queued--;
+
+  Job* job = task.job;
+  try {
+    (*task.fn)(task.begin, task.end);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (!job->error) job->error = std::current_exception();
+  }
+  // the job may be destroyed as soon as this reaches zero.
+  job->pending--;
+  return true;
+}
+
+void shf::ThreadPool::WorkerLoop(std::size_t self) {
+  t_pool = this;
+  t_queue = self;
+  while (true) {
+    if (TryRunTask(self)) continue;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+    if (m_stop) return;
+  }
+}
+
+void shf::ParallelFor(shf::ThreadPool* pool, std::size_t n,
+                      const shf::ThreadPool::RangeFunction& fn) {
+  if (pool)
+    pool->ParallelFor(n, fn);
+  else if (n)
+    fn(0, n);
+}
+
+std::size_t shf::ParallelBlocks(const shf::ThreadPool* pool, std::size_t n) {
+  if (!pool || n < 2) return 1;
+  return std::min(n, pool->Size());
+}
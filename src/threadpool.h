@@ -0,0 +1,131 @@
+#ifndef SHF_THREADPOOL_H
+#define SHF_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace shf {
+
+/**
+ * @brief A work-stealing thread pool for data parallel loops.
+ *
+ * Every worker owns a queue of tasks. Workers take tasks from the back of
+ * their own queue and steal from the front of the other queues when theirs
+ * is empty. A thread waiting on a ParallelFor executes tasks as well, so
+ * loops can be nested without deadlocking the pool.
+ */
+class ThreadPool {
+ public:
+  using RangeFunction = std::function<void(std::size_t, std::size_t)>;
+
+  /**
+   * @brief Create a thread pool.
+   * @param threads the number of threads working on a loop, including the
+   * thread that calls ParallelFor. 0 means one per hardware thread.
+   */
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  /**
+   * @brief Number of threads that work on a loop.
+   */
+  std::size_t Size() const { return m_workers.size() + 1; };
+
+  /**
+   * @brief Run a function over a range split into chunks.
+   *
+   * The chunks are disjoint and cover [0, n). This call returns once all
+   * chunks are done, and rethrows the first exception thrown by a chunk.
+   *
+   * @param n the size of the range
+   * @param fn function called as fn(begin, end) for every chunk
+   */
+  void ParallelFor(std::size_t n, const RangeFunction& fn);
+
+ private:
+  struct Job;
+
+  struct Task {
+    const RangeFunction* fn;
+    std::size_t begin;
+    std::size_t end;
+    Job* job;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool TryRunTask(std::size_t self);
+  void WorkerLoop(std::size_t self);
+  std::size_t OwnQueue() const;
+
+  // one queue per worker, plus one shared by threads outside the pool.
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::atomic<std::ptrdiff_t> m_queued{0};
+  bool m_stop = false;
+};
+
+/**
+ * @brief Run fn over [0, n) on a thread pool, or inline if there is none.
+ * @param pool the pool to use. May be null
+ * @param n the size of the range
+ * @param fn function called as fn(begin, end) for every chunk
+ */
+void ParallelFor(ThreadPool* pool, std::size_t n,
+                 const ThreadPool::RangeFunction& fn);
+
+/**
+ * @brief Number of blocks to split a reduction over n elements into.
+ * @param pool the pool to use. May be null
+ * @param n the number of elements
+ * @return a number between 1 and n (or 1 if n is 0).
+ */
+std::size_t ParallelBlocks(const ThreadPool* pool, std::size_t n);
+
+/**
+ * @brief Reduce [0, n) on a thread pool.
+ *
+ * The range is split into the same blocks for any pool of the same size, and
+ * partial results are combined in block order, so the result only depends on
+ * the input when the reduction is associative.
+ *
+ * @param pool the pool to use. May be null
+ * @param n the size of the range
+ * @param init the value of an empty reduction
+ * @param map function computing the partial result of map(begin, end)
+ * @param reduce function combining two partial results
+ * @return the reduction of all partial results.
+ */
+template <typename T, typename Map, typename Reduce>
+T ParallelReduce(ThreadPool* pool, std::size_t n, const T& init, Map map,
+                 Reduce reduce) {
+  const std::size_t blocks = ParallelBlocks(pool, n);
+  std::vector<T> partial(blocks, init);
+  ParallelFor(pool, blocks, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t b = begin; b < end; ++b)
+      partial[b] = map(n * b / blocks, n * (b + 1) / blocks);
+  });
+  T r = init;
+  for (const auto& p : partial) r = reduce(r, p);
+  return r;
+}
+
+}  // namespace shf
+
+#endif  // SHF_THREADPOOL_H
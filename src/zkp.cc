@@ -1,6 +1,9 @@
 #include "zkp.h"
 
 #include <iostream>
+#include <stdexcept>
+
+#include "multiexp.h"
 
 static inline shf::Scalar DLogChallenge(shf::Hash& hash, const shf::Point& p0,
                                        const shf::Point& p1,
@@ -27,9 +30,60 @@ bool shf::VerifyProof(const shf::DLogS& statement, shf::Hash& hash,
   const Point B = statement.B;
   const Point P = statement.P;
   const Scalar c = DLogChallenge(hash, B, P, T);
-  const Point cP = c * P;
-  const Point rB = r * B;
-  return cP + rB == T;
+  return Point::MulSim(c, P, r, B) == T;
+}
+
+// Challenges of the proofs in [begin, end) of a batch, where proof i absorbs
+// the k points at points[i * k]. The points are encoded together and the
+// hashes are advanced together, which is faster than one challenge at a time.
+static inline void BatchChallenges(std::vector<shf::Hash>& hashes,
+                                   const std::vector<const shf::Point*>& points,
+                                   std::size_t k, std::size_t begin,
+                                   std::size_t end,
+                                   std::vector<shf::Scalar>& cs) {
+  const std::size_t n = k * shf::Point::ByteSize();
+  std::vector<uint8_t> data((end - begin) * n);
+  shf::Point::WriteBatch(points.data() + begin * k, (end - begin) * k,
+                         data.data());
+  shf::Hash::UpdateMany(&hashes[begin], end - begin, data.data(), n);
+  shf::ScalarFromHashes(&hashes[begin], end - begin, &cs[begin]);
+}
+
+// Returns a base equal to P with the same address as the previous one when
+// possible, so that a batch merges terms on a base shared by many statements.
+static inline const shf::Point& SharedBase(const shf::Point*& last,
+                                           const shf::Point& P) {
+  if (!last || *last != P) last = &P;
+  return *last;
+}
+
+bool shf::BatchVerify(const std::vector<shf::DLogS>& statements,
+                     const std::vector<shf::DLogP>& proofs,
+                     std::vector<shf::Hash>& hashes, shf::ThreadPool* pool) {
+  const std::size_t n = statements.size();
+  if (proofs.size() != n || hashes.size() != n)
+    throw std::invalid_argument("need a proof and a hash per statement");
+
+  // w[i] * (c[i]*P[i] + r[i]*B[i] - T[i])
+  MultiExpBatch batch;
+  std::vector<Scalar> cs(n);
+  const std::vector<Scalar> ws = batch.Weights(n);
+  std::vector<const Point*> points;
+  points.reserve(3 * n);
+  for (std::size_t i = 0; i < n; ++i)
+    points.insert(points.end(),
+                  {&statements[i].B, &statements[i].P, &proofs[i].T});
+  ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    BatchChallenges(hashes, points, 3, begin, end, cs);
+  });
+
+  const Point* B = nullptr;
+  for (std::size_t i = 0; i < n; ++i) {
+    batch.Add(ws[i] * cs[i], statements[i].P);
+    batch.Add(ws[i] * proofs[i].r, SharedBase(B, statements[i].B));
+    batch.Add(-ws[i], proofs[i].T);
+  }
+  return batch.Evaluate(pool).IsInfinity();
 }
 
 static inline shf::Scalar DLogEqChallenge(shf::Hash& hash, const shf::Point& p0,
@@ -66,11 +120,48 @@ bool shf::VerifyProof(const shf::DLogEqS& statement, shf::Hash& hash,
   const Point K = proof.K;
   const Scalar r = proof.r;
   const Scalar c = DLogEqChallenge(hash, G, A, H, B, T, K);
-  const Point cA = c * A;
-  const Point cB = c * B;
-  const Point rG = r * G;
-  const Point rH = r * H;
-  return rG == T - cA && rH == K - cB;
+  // rG == T - cA and rH == K - cB
+  return Point::MulSim(r, G, c, A) == T && Point::MulSim(r, H, c, B) == K;
+}
+
+bool shf::BatchVerify(const std::vector<shf::DLogEqS>& statements,
+                     const std::vector<shf::DLogEqP>& proofs,
+                     std::vector<shf::Hash>& hashes, shf::ThreadPool* pool) {
+  const std::size_t n = statements.size();
+  if (proofs.size() != n || hashes.size() != n)
+    throw std::invalid_argument("need a proof and a hash per statement");
+
+  // u[i] * (r[i]*G[i] + c[i]*A[i] - T[i])
+  // v[i] * (r[i]*H[i] + c[i]*B[i] - K[i])
+  MultiExpBatch batch;
+  std::vector<Scalar> cs(n);
+  const std::vector<Scalar> us = batch.Weights(n);
+  const std::vector<Scalar> vs = batch.Weights(n);
+  std::vector<const Point*> points;
+  points.reserve(6 * n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto& stmt = statements[i];
+    const auto& proof = proofs[i];
+    points.insert(points.end(),
+                  {&stmt.G, &stmt.A, &stmt.H, &stmt.B, &proof.T, &proof.K});
+  }
+  ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    BatchChallenges(hashes, points, 6, begin, end, cs);
+  });
+
+  const Point* G = nullptr;
+  const Point* H = nullptr;
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto& stmt = statements[i];
+    const auto& proof = proofs[i];
+    batch.Add(us[i] * proof.r, SharedBase(G, stmt.G));
+    batch.Add(us[i] * cs[i], stmt.A);
+    batch.Add(-us[i], proof.T);
+    batch.Add(vs[i] * proof.r, SharedBase(H, stmt.H));
+    batch.Add(vs[i] * cs[i], stmt.B);
+    batch.Add(-vs[i], proof.K);
+  }
+  return batch.Evaluate(pool).IsInfinity();
 }
 
 // create a vector and reserve a size
@@ -86,12 +177,10 @@ static inline shf::Scalar ProductChallenge(shf::Hash& hash, const shf::Point& C0
 }
 
 shf::ProductP shf::CreateProof(const shf::CommitKey& ck, shf::Hash& hash,
-                             const shf::ProductS& statement,
+                             const shf::ProductS& /* statement */,
                              const std::vector<shf::Scalar>& w0,
-                             const shf::Scalar& w1) {
+                             const shf::Scalar& w1, shf::ThreadPool* pool) {
   const auto n = w0.size();
-  const auto C = statement.C;
-  const auto b = statement.b;
 
   SCALAR_VECTOR(ds, n);
   SCALAR_VECTOR(bs, n);
@@ -107,27 +196,31 @@ shf::ProductP shf::CreateProof(const shf::CommitKey& ck, shf::Hash& hash,
   es[0] = ds[0];
   es[n - 1] = Scalar();
 
-  SCALAR_VECTOR(sd, n - 1);
-  SCALAR_VECTOR(bd, n - 1);
+  std::vector<Scalar> sd(n - 1);
+  std::vector<Scalar> bd(n - 1);
 
-  for (std::size_t i = 0; i < n - 1; ++i) {
-    sd.emplace_back(-es[i] * ds[i + 1]);
-    bd.emplace_back(es[i + 1] - w0[i + 1] * es[i] - bs[i] * ds[i + 1]);
-  }
+  ParallelFor(pool, n - 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      sd[i] = -es[i] * ds[i + 1];
+      bd[i] = es[i + 1] - w0[i + 1] * es[i] - bs[i] * ds[i + 1];
+    }
+  });
 
-  const auto Cr0 = Commit(ck, ds);
-  const auto Cr1 = Commit(ck, sd);
-  const auto Cr2 = Commit(ck, bd);
+  const auto Cr0 = Commit(ck, ds, pool);
+  const auto Cr1 = Commit(ck, sd, pool);
+  const auto Cr2 = Commit(ck, bd, pool);
 
   const auto c = ProductChallenge(hash, Cr0.C, Cr1.C, Cr2.C);
 
-  SCALAR_VECTOR(aa, n);
-  SCALAR_VECTOR(bb, n);
+  std::vector<Scalar> aa(n);
+  std::vector<Scalar> bb(n);
 
-  for (std::size_t i = 0; i < n; ++i) {
-    aa.emplace_back(c * w0[i] + ds[i]);
-    bb.emplace_back(c * bs[i] + es[i]);
-  }
+  ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      aa[i] = c * w0[i] + ds[i];
+      bb[i] = c * bs[i] + es[i];
+    }
+  });
 
   const auto r = c * w1 + Cr0.r;
   const auto s = c * Cr2.r + Cr1.r;
@@ -135,37 +228,45 @@ shf::ProductP shf::CreateProof(const shf::CommitKey& ck, shf::Hash& hash,
   return {Cr0.C, Cr1.C, Cr2.C, aa, bb, r, s};
 }
 
-bool shf::VerifyProof(const shf::CommitKey& ck, shf::Hash& hash,
-                     const shf::ProductS& statement, const shf::ProductP& proof) {
-  const auto C0 = proof.C0;
-  const auto C1 = proof.C1;
-  const auto C2 = proof.C2;
-
-  const auto c = ProductChallenge(hash, C0, C1, C2);
-
-  const auto C = statement.C;
-  const auto lhs0 = c * C + C0;
-  const auto lhs1 = c * C2 + C1;
-
-  Point rhs0, rhs1;
-  std::size_t i = 0;
-  const auto as = proof.as;
-  const auto bs = proof.bs;
-  const auto b = statement.b;
-  for (; i < as.size() - 2; ++i) {
-    const auto Gi = ck.G[i];
-    rhs0 += Gi * as[i];
-    rhs1 += Gi * (c * bs[i + 1] - bs[i] * as[i + 1]);
-  }
-  rhs0 += ck.G[i] * as[i];
-  rhs1 += ck.G[i] * (c * c * b - bs[i] * as[i + 1]);
-  i++;
-  rhs0 += ck.G[i] * as[i];
-
-  const auto r = proof.r;
-  const auto s = proof.s;
+bool shf::AddToBatch(shf::MultiExpBatch& batch, const shf::CommitKey& ck,
+                    shf::Hash& hash, const shf::ProductS& statement,
+                    const shf::ProductP& proof) {
+  const auto& as = proof.as;
+  const auto& bs = proof.bs;
+  const std::size_t n = as.size();
+  if (n < 2 || bs.size() != n || n > ck.Size()) return false;
+
+  const auto c = ProductChallenge(hash, proof.C0, proof.C1, proof.C2);
+  const std::vector<Scalar> ws = batch.Weights(2);
+  const auto& w0 = ws[0];
+  const auto& w1 = ws[1];
+
+  // w0 * (c*C + C0 - sum_i as[i]*G[i] - r*H)
+  batch.Add(w0 * c, statement.C);
+  batch.Add(w0, proof.C0);
+  for (std::size_t i = 0; i < n; ++i) batch.Add(-(w0 * as[i]), ck.G[i]);
+  batch.Add(-(w0 * proof.r), ck.H.Base());
+
+  // w1 * (c*C2 + C1 - sum_i cs[i]*G[i] - s*H), with cs as in VerifyProof.
+  batch.Add(w1 * c, proof.C2);
+  batch.Add(w1, proof.C1);
+  for (std::size_t i = 0; i < n - 2; ++i)
+    batch.Add(-(w1 * (c * bs[i + 1] - bs[i] * as[i + 1])), ck.G[i]);
+  batch.Add(-(w1 * (c * c * statement.b - bs[n - 2] * as[n - 1])),
+            ck.G[n - 2]);
+  batch.Add(-(w1 * proof.s), ck.H.Base());
+
+  return true;
+}
 
-  return lhs0 == rhs0 + ck.H * r && lhs1 == rhs1 + ck.H * s;
+bool shf::VerifyProof(const shf::CommitKey& ck, shf::Hash& hash,
+                     const shf::ProductS& statement, const shf::ProductP& proof,
+                     shf::ThreadPool* pool) {
+  // both equations are checked with one multi exponentiation, so that every
+  // G[i] is only multiplied once.
+  MultiExpBatch batch;
+  return AddToBatch(batch, ck, hash, statement, proof) &&
+         batch.Evaluate(pool).IsInfinity();
 }
 
 static inline shf::CommitmentAndRandomness CommitOne(const shf::CommitKey& ck,
@@ -175,79 +276,120 @@ static inline shf::CommitmentAndRandomness CommitOne(const shf::CommitKey& ck,
 }
 
 static inline void HashStatement(shf::Hash& hash,
-                                 const shf::MultiExpS& statement) {
-  const auto Es = statement.Es;
-  const auto E = statement.E;
-  const auto C = statement.C;
-  hash.Update(E.U).Update(E.V).Update(C);
-  for (const auto& ctxt : Es) hash.Update(ctxt.U).Update(ctxt.V);
-}
-
-static inline shf::Scalar MultiExpChallenge(shf::Hash& hash,
-                                           const shf::MultiExpS& statement,
-                                           const shf::Point& C0,
-                                           const shf::Point& C1,
-                                           const shf::Ctxt& E) {
-  HashStatement(hash, statement);
+                                 const shf::MultiExpS& statement,
+                                 const std::vector<shf::Ctxt>& Es,
+                                 const shf::Digest* Es_digest) {
+  const auto& E = statement.E;
+  hash.Update(E.U).Update(E.V).Update(statement.C);
+  if (Es_digest)
+    hash.Update(Es_digest->data(), Es_digest->size());
+  else
+    hash.Update(Es);
+}
+
+static inline shf::Scalar MultiExpChallenge(
+    shf::Hash& hash, const shf::MultiExpS& statement,
+    const std::vector<shf::Ctxt>& Es, const shf::Point& C0,
+    const shf::Point& C1, const shf::Ctxt& E, const shf::Digest* Es_digest) {
+  HashStatement(hash, statement, Es, Es_digest);
   hash.Update(C0).Update(C1).Update(E.U).Update(E.V);
   return shf::ScalarFromHash(hash);
 }
 
 static inline std::vector<shf::Scalar> MulAndSum(
     const std::vector<shf::Scalar>& a, const std::vector<shf::Scalar>& b,
-    const shf::Scalar& x) {
+    const shf::Scalar& x, shf::ThreadPool* pool) {
   const auto n = a.size();
-  SCALAR_VECTOR(c, n);
-  for (std::size_t i = 0; i < n; ++i) c.emplace_back(a[i] + b[i] * x);
+  std::vector<shf::Scalar> c(n);
+  shf::ParallelFor(pool, n, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) c[i] = a[i] + b[i] * x;
+  });
   return c;
 }
 
 shf::MultiExpP shf::CreateProof(const shf::CommitKey& ck, const shf::PublicKey& pk,
                               shf::Hash& hash, const shf::MultiExpS& statement,
                               const std::vector<shf::Scalar>& w0,
-                              const shf::Scalar& w1, const shf::Scalar& w2) {
+                              const shf::Scalar& w1, const shf::Scalar& w2,
+                              shf::ThreadPool* pool,
+                              const shf::Digest* Es_digest) {
   const std::size_t n = w0.size();
-  const std::vector<Ctxt> Es = statement.Es;
-  const Ctxt E = statement.E;
-  const Point C = statement.C;
+  const std::vector<Ctxt>& Es = statement.Es;
 
   SCALAR_VECTOR(a0, n);
   for (std::size_t i = 0; i < n; ++i) a0.emplace_back(Scalar::CreateRandom());
 
-  const CommitmentAndRandomness Cr0 = Commit(ck, a0);
+  const CommitmentAndRandomness Cr0 = Commit(ck, a0, pool);
 
   const Scalar b = Scalar::CreateRandom();
   const CommitmentAndRandomness Crb = CommitOne(ck, b);
 
   const Scalar t = Scalar::CreateRandom();
-  const Point bG = b * Point::Generator();
-  const Ctxt E0 = shf::Add(shf::Encrypt(pk, bG, t), shf::Dot(a0, Es));
+  const Point bG = Point::MulGenerator(b);
+  const Ctxt E0 = shf::Add(shf::Encrypt(pk, bG, t), shf::Dot(a0, Es, pool));
 
-  const Scalar c = MultiExpChallenge(hash, statement, Cr0.C, Crb.C, E0);
+  const Scalar c =
+      MultiExpChallenge(hash, statement, Es, Cr0.C, Crb.C, E0, Es_digest);
 
-  const std::vector<Scalar> aa = MulAndSum(a0, w0, c);
+  const std::vector<Scalar> aa = MulAndSum(a0, w0, c, pool);
   const Scalar rr = Cr0.r + w1 * c;
   const Scalar tt = t + w2 * c;
 
   return {Cr0.C, Crb.C, E0, aa, rr, b, Crb.r, tt};
 }
 
-static inline bool CtxtEqual(const shf::Ctxt& E0, const shf::Ctxt& E1) {
-  return E0.U == E1.U && E0.V == E1.V;
+// the generator at a fixed address, so that batches merge all terms on it.
+static inline const shf::Point& BatchGenerator() {
+  static const shf::Point g = shf::Point::Generator();
+  return g;
+}
+
+bool shf::AddToBatch(shf::MultiExpBatch& batch, const shf::CommitKey& ck,
+                    const shf::PublicKey& pk, shf::Hash& hash,
+                    const shf::MultiExpS& statement,
+                    const shf::MultiExpP& proof,
+                    const shf::Digest* Es_digest,
+                    const std::vector<shf::Ctxt>* Es_ptr) {
+  const auto& Es = Es_ptr ? *Es_ptr : statement.Es;
+  const auto& a = proof.a;
+  const std::size_t n = a.size();
+  if (Es.size() != n || n > ck.Size()) return false;
+
+  const auto c = MultiExpChallenge(hash, statement, Es, proof.C0, proof.C1,
+                                   proof.E, Es_digest);
+  const std::vector<Scalar> ws = batch.Weights(3);
+  const auto& w0 = ws[0];
+  const auto& w1 = ws[1];
+  const auto& w2 = ws[2];
+
+  // w0 * (C0 + c*C - sum_i a[i]*G[i] - r*H)
+  batch.Add(w0, proof.C0);
+  batch.Add(w0 * c, statement.C);
+  for (std::size_t i = 0; i < n; ++i) batch.Add(-(w0 * a[i]), ck.G[i]);
+  batch.Add(-(w0 * proof.r), ck.H.Base());
+
+  // w1 * (E.U + c*E'.U - t*G - sum_i a[i]*Es[i].U)
+  // w2 * (E.V + c*E'.V - b*G - t*pk - sum_i a[i]*Es[i].V)
+  batch.Add(w1, proof.E.U);
+  batch.Add(w2, proof.E.V);
+  batch.Add(w1 * c, statement.E.U);
+  batch.Add(w2 * c, statement.E.V);
+  batch.Add(-(w1 * proof.t + w2 * proof.b), BatchGenerator());
+  batch.Add(-(w2 * proof.t), pk);
+  for (std::size_t i = 0; i < n; ++i) {
+    batch.Add(-(w1 * a[i]), Es[i].U);
+    batch.Add(-(w2 * a[i]), Es[i].V);
+  }
+
+  return true;
 }
 
 bool shf::VerifyProof(const shf::CommitKey& ck, const shf::PublicKey& pk,
                      shf::Hash& hash, const shf::MultiExpS& statement,
-                     const shf::MultiExpP& proof) {
-  const auto c =
-      MultiExpChallenge(hash, statement, proof.C0, proof.C1, proof.E);
-
-  const Point C = proof.C0 + c * statement.C;
-  // E0 = E + c*E
-  // E1 = Enc(pk, 1, t) + Es^a
-  const Ctxt E0 = Add(proof.E, Multiply(c, statement.E));
-  const Ctxt E1 = Add(Encrypt(pk, Point::Generator() * proof.b, proof.t),
-                      Dot(proof.a, statement.Es));
-
-  return C == Commit(ck, proof.r, proof.a) && CtxtEqual(E0, E1);
+                     const shf::MultiExpP& proof, shf::ThreadPool* pool) {
+  // the commitment and both halves of the ciphertext equality are checked
+  // with one multi exponentiation.
+  MultiExpBatch batch;
+  return AddToBatch(batch, ck, pk, hash, statement, proof) &&
+         batch.Evaluate(pool).IsInfinity();
 }
@@ -7,6 +7,8 @@
 #include "commit.h"
 #include "curve.h"
 #include "hash.h"
+#include "multiexp.h"
+#include "threadpool.h"
 
 namespace shf {
 
@@ -46,6 +48,23 @@ DLogP CreateProof(const DLogS& statement, Hash& hash, const Scalar& w);
  */
 bool VerifyProof(const DLogS& statement, Hash& hash, const DLogP& proof);
 
+/**
+ * @brief Verify many proofs of knowledge of discrete logarithm at once.
+ *
+ * The equations of all proofs are combined with random weights and checked
+ * with a single multi-exponentiation. A base shared by consecutive
+ * statements, such as a common generator, is multiplied only once.
+ *
+ * @param statements the proof statements
+ * @param proofs the proofs to verify, one per statement
+ * @param hashes a hash function object per statement
+ * @param pool optional thread pool to spread the work over
+ * @return true if all proofs are valid and false otherwise.
+ */
+bool BatchVerify(const std::vector<DLogS>& statements,
+                 const std::vector<DLogP>& proofs, std::vector<Hash>& hashes,
+                 ThreadPool* pool = nullptr);
+
 /**
  * @brief Knowledge of equality of discrete log.
  *
@@ -86,6 +105,19 @@ DLogEqP CreateProof(const DLogEqS& statement, Hash& hash, const Scalar& w);
  */
 bool VerifyProof(const DLogEqS& statement, Hash& hash, const DLogEqP& proof);
 
+/**
+ * @brief Verify many proofs of equality of discrete logs at once. See the
+ * DLogS overload.
+ * @param statements the proof statements
+ * @param proofs the proofs to verify, one per statement
+ * @param hashes a hash function object per statement
+ * @param pool optional thread pool to spread the work over
+ * @return true if all proofs are valid and false otherwise.
+ */
+bool BatchVerify(const std::vector<DLogEqS>& statements,
+                 const std::vector<DLogEqP>& proofs, std::vector<Hash>& hashes,
+                 ThreadPool* pool = nullptr);
+
 /*
  * The next part of the header contains definitions of the sub-proofs needed to
  * construct proofs of correctness a shuffle. These two proofs are
@@ -132,21 +164,47 @@ struct ProductP {
  * @param statement the statement
  * @param w0 witness (messages that are in the commitment)
  * @param w1 witness (randomness used for commitment)
+ * @param pool optional thread pool to spread the work over
  * @return a proof.
  */
 ProductP CreateProof(const CommitKey& ck, Hash& hash, const ProductS& statement,
-                     const std::vector<Scalar>& w0, const Scalar& w1);
+                     const std::vector<Scalar>& w0, const Scalar& w1,
+                     ThreadPool* pool = nullptr);
 
 /**
  * @brief Verify a product proof.
+ *
+ * Both equations of the proof are combined with random weights and checked
+ * with one multi-exponentiation.
+ *
  * @param ck a commitment key
  * @param hash a hash function object
  * @param statement the statement
  * @param proof the proof to verify
+ * @param pool optional thread pool to spread the work over
  * @return true if the proof is valid and false otherwise.
  */
 bool VerifyProof(const CommitKey& ck, Hash& hash, const ProductS& statement,
-                 const ProductP& proof);
+                 const ProductP& proof, ThreadPool* pool = nullptr);
+
+/**
+ * @brief Add the equations checked by VerifyProof for a product proof to a
+ * batch.
+ *
+ * Every equation is multiplied by a fresh random weight, so if the batch sums
+ * to the identity, all proofs added to it are valid except with negligible
+ * probability. The batch refers to the commitment key, statement and proof,
+ * which must outlive it.
+ *
+ * @param batch the batch to add to
+ * @param ck a commitment key
+ * @param hash a hash function object
+ * @param statement the statement
+ * @param proof the proof to verify
+ * @return false if the proof is malformed, in which case nothing is added.
+ */
+bool AddToBatch(MultiExpBatch& batch, const CommitKey& ck, Hash& hash,
+                const ProductS& statement, const ProductP& proof);
 
 struct MultiExpS {
   std::vector<Ctxt> Es;
@@ -174,23 +232,55 @@ struct MultiExpP {
  * @param w0 witness (messages in a commitment)
  * @param w1 witness (randomness for a commitment)
  * @param w2 witness (randomness for an encryption of 1)
+ * @param pool optional thread pool to spread the work over
+ * @param Es_digest optional ListDigest of statement.Es, which is absorbed
+ * in place of the ciphertexts
  * @return a proof.
  */
 MultiExpP CreateProof(const CommitKey& ck, const PublicKey& pk, Hash& hash,
                       const MultiExpS& statement, const std::vector<Scalar>& w0,
-                      const Scalar& w1, const Scalar& w2);
+                      const Scalar& w1, const Scalar& w2,
+                      ThreadPool* pool = nullptr,
+                      const Digest* Es_digest = nullptr);
 
 /**
  * @brief Verify a multi exponent proof.
+ *
+ * The commitment and ciphertext equations are combined with random weights
+ * and checked with one multi-exponentiation.
+ *
  * @param ck a commit key
  * @param pk a public key
  * @param hash a hash function object
  * @param statement a statement
  * @param proof the proof to verify
+ * @param pool optional thread pool to spread the work over
  * @return true if the proof is valid and false otherwise.
  */
 bool VerifyProof(const CommitKey& ck, const PublicKey& pk, Hash& hash,
-                 const MultiExpS& statement, const MultiExpP& proof);
+                 const MultiExpS& statement, const MultiExpP& proof,
+                 ThreadPool* pool = nullptr);
+
+/**
+ * @brief Add the equations checked by VerifyProof for a multi exponent proof
+ * to a batch. See the product proof overload.
+ * @param batch the batch to add to
+ * @param ck a commit key
+ * @param pk a public key
+ * @param hash a hash function object
+ * @param statement a statement
+ * @param proof the proof to verify
+ * @param Es_digest optional ListDigest of statement.Es, as passed to
+ * CreateProof
+ * @param Es optional ciphertexts used in place of statement.Es, so that a
+ * caller which already holds them need not copy them into the statement. The
+ * batch refers to them, so they must outlive it.
+ * @return false if the proof is malformed, in which case nothing is added.
+ */
+bool AddToBatch(MultiExpBatch& batch, const CommitKey& ck,
+                const PublicKey& pk, Hash& hash, const MultiExpS& statement,
+                const MultiExpP& proof, const Digest* Es_digest = nullptr,
+                const std::vector<Ctxt>* Es = nullptr);
 
 }  // namespace mh
 
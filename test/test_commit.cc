@@ -0,0 +1,70 @@
+#include <catch2/catch.hpp>
+#include <vector>
+
+#include "commit.h"
+
+static inline bool SameKey(const shf::CommitKey& a, const shf::CommitKey& b) {
+  if (a.Size() != b.Size() || a.H.Base() != b.H.Base()) return false;
+  for (std::size_t i = 0; i < a.Size(); ++i)
+    if (a.G[i] != b.G[i]) return false;
+  return true;
+}
+
+TEST_CASE("commit key from seed") {
+  shf::CurveInit();
+
+  const std::size_t n = 64;
+  const uint8_t seed0[] = {1, 2, 3, 4};
+  const uint8_t seed1[] = {1, 2, 3, 5};
+
+  const auto ck = shf::CreateCommitKey(n, seed0, sizeof(seed0));
+
+  SECTION("is reproducible") {
+    REQUIRE(SameKey(ck, shf::CreateCommitKey(n, seed0, sizeof(seed0))));
+
+    shf::ThreadPool pool(4);
+    REQUIRE(SameKey(ck, shf::CreateCommitKey(n, seed0, sizeof(seed0), &pool)));
+
+    // a shorter key is a prefix of a longer one.
+    const auto small = shf::CreateCommitKey(n / 2, seed0, sizeof(seed0));
+    for (std::size_t i = 0; i < small.Size(); ++i)
+      REQUIRE(small.G[i] == ck.G[i]);
+  }
+
+  SECTION("depends on the seed") {
+    const auto other = shf::CreateCommitKey(n, seed1, sizeof(seed1));
+    REQUIRE(other.H.Base() != ck.H.Base());
+    for (std::size_t i = 0; i < n; ++i) REQUIRE(other.G[i] != ck.G[i]);
+  }
+
+  SECTION("generators are distinct") {
+    for (std::size_t i = 0; i < n; ++i) {
+      REQUIRE(ck.G[i] != ck.H.Base());
+      REQUIRE(!ck.G[i].IsInfinity());
+      for (std::size_t j = i + 1; j < n; ++j) REQUIRE(ck.G[i] != ck.G[j]);
+    }
+  }
+
+  SECTION("commits") {
+    std::vector<shf::Scalar> m;
+    for (std::size_t i = 0; i < n; ++i)
+      m.emplace_back(shf::Scalar::CreateRandom());
+    const auto Cr = shf::Commit(ck, m);
+    REQUIRE(shf::CheckCommitment(ck, Cr.C, Cr.r, m));
+  }
+
+  SECTION("spot check") {
+    REQUIRE(shf::SpotCheckCommitKey(ck, seed0, sizeof(seed0), 16));
+    REQUIRE(!shf::SpotCheckCommitKey(ck, seed1, sizeof(seed1), 16));
+
+    // a key with the right H but other generators.
+    shf::CommitKey planted = shf::CreateCommitKey(n);
+    planted.H = ck.H;
+    REQUIRE(!shf::SpotCheckCommitKey(planted, seed0, sizeof(seed0), 16));
+  }
+
+  SECTION("size 0") {
+    REQUIRE_THROWS_AS(shf::CreateCommitKey(0, seed0, sizeof(seed0)),
+                      std::invalid_argument);
+  }
+}
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "cipher.h"
+#include "commit.h"
+#include "threadpool.h"
+
+static const std::size_t kThreads = 8;
+
+TEST_CASE("concurrent curve use") {
+  // every thread initializes, as a worker would on startup.
+  std::vector<std::thread> init;
+  for (std::size_t t = 0; t < kThreads; ++t)
+    init.emplace_back([] { shf::CurveInit(); });
+  for (auto& t : init) t.join();
+
+  const std::size_t n = 20;
+  const auto ck = shf::CreateCommitKey(n);
+  const auto sk = shf::CreateSecretKey();
+  const auto pk = shf::CreatePublicKey(sk);
+
+  SECTION("encrypt and commit") {
+    std::vector<int> ok(kThreads, 0);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&, t] {
+        bool good = true;
+        for (std::size_t i = 0; i < 10; ++i) {
+          const auto m = shf::Point::CreateRandom();
+          good &= shf::Decrypt(sk, shf::Encrypt(pk, m)) == m;
+
+          std::vector<shf::Scalar> v;
+          for (std::size_t j = 0; j < n; ++j)
+            v.emplace_back(shf::Scalar::CreateRandom());
+          const auto Cr = shf::Commit(ck, v);
+          good &= shf::CheckCommitment(ck, Cr.C, Cr.r, v);
+        }
+        ok[t] = good;
+      });
+    }
+    for (auto& t : threads) t.join();
+    for (std::size_t t = 0; t < kThreads; ++t) REQUIRE(ok[t]);
+  }
+
+  SECTION("same result on every thread") {
+    const auto m = shf::Point::CreateRandom();
+    const auto r = shf::Scalar::CreateRandom();
+    const auto expected = shf::Encrypt(pk, m, r);
+
+    std::vector<shf::Ctxt> results(kThreads);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kThreads; ++t)
+      threads.emplace_back([&, t] { results[t] = shf::Encrypt(pk, m, r); });
+    for (auto& t : threads) t.join();
+    for (const auto& E : results) {
+      REQUIRE(E.U == expected.U);
+      REQUIRE(E.V == expected.V);
+    }
+  }
+}
+
+TEST_CASE("thread pool") {
+  shf::ThreadPool pool(4);
+  REQUIRE(pool.Size() == 4);
+
+  SECTION("every index is visited once") {
+    const std::size_t n = 1000;
+    std::vector<std::atomic<int>> seen(n);
+    pool.ParallelFor(n, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) seen[i]++;
+    });
+    for (std::size_t i = 0; i < n; ++i) REQUIRE(seen[i] == 1);
+  }
+
+  SECTION("nested loops") {
+    const std::size_t n = 16;
+    std::vector<std::atomic<int>> seen(n * n);
+    pool.ParallelFor(n, [&](std::size_t b0, std::size_t e0) {
+      for (std::size_t i = b0; i < e0; ++i)
+        pool.ParallelFor(n, [&](std::size_t b1, std::size_t e1) {
+          for (std::size_t j = b1; j < e1; ++j) seen[i * n + j]++;
+        });
+    });
+    for (std::size_t i = 0; i < n * n; ++i) REQUIRE(seen[i] == 1);
+  }
+
+  SECTION("exceptions are propagated") {
+    REQUIRE_THROWS_AS(
+        pool.ParallelFor(100,
+                         [](std::size_t begin, std::size_t) {
+                           if (begin == 0) throw std::runtime_error("chunk");
+                         }),
+        std::runtime_error);
+    // the pool is still usable afterwards.
+    std::atomic<std::size_t> count{0};
+    pool.ParallelFor(10, [&](std::size_t begin, std::size_t end) {
+      count += end - begin;
+    });
+    REQUIRE(count == 10);
+  }
+
+  SECTION("reduce") {
+    const std::size_t n = 1234;
+    const auto sum = [](std::size_t begin, std::size_t end) {
+      std::size_t s = 0;
+      for (std::size_t i = begin; i < end; ++i) s += i;
+      return s;
+    };
+    const auto add = [](std::size_t a, std::size_t b) { return a + b; };
+    REQUIRE(shf::ParallelReduce(&pool, n, std::size_t{0}, sum, add) ==
+            n * (n - 1) / 2);
+    REQUIRE(shf::ParallelReduce<std::size_t>(nullptr, n, 0, sum, add) ==
+            n * (n - 1) / 2);
+    REQUIRE(shf::ParallelReduce<std::size_t>(&pool, 0, 7, sum, add) == 7);
+  }
+}
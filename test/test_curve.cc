@@ -1,6 +1,10 @@
 #include <catch2/catch.hpp>
 
+#include <type_traits>
+#include <vector>
+
 #include "curve.h"
+#include "threadpool.h"
 
 TEST_CASE("point") {
   shf::CurveInit();
@@ -35,6 +39,94 @@ TEST_CASE("point") {
     REQUIRE(p * x == x * p);
     REQUIRE((p * x) * y == (p * y) * x);
   }
+
+  SECTION("simultaneous mul") {
+    const auto p = shf::Point::CreateRandom();
+    const auto q = shf::Point::CreateRandom();
+    const auto x = shf::Scalar::CreateRandom();
+    const auto y = shf::Scalar::CreateRandom();
+    REQUIRE(shf::Point::MulSim(x, p, y, q) == x * p + y * q);
+    REQUIRE(shf::Point::MulSim(x, p, y, p) == (x + y) * p);
+    REQUIRE(shf::Point::MulSim(shf::Scalar(), p, y, q) == y * q);
+    REQUIRE(shf::Point::MulSim(x, p, y, shf::Point()) == x * p);
+  }
+
+  SECTION("read write") {
+    using Encoding = shf::Point::Encoding;
+    for (const auto e : {Encoding::kCompressed, Encoding::kUncompressed}) {
+      std::vector<uint8_t> buf(shf::Point::ByteSize(e));
+      const auto p = shf::Point::CreateRandom();
+      p.Write(buf.data(), e);
+      REQUIRE(shf::Point::Read(buf.data(), e) == p);
+      shf::Point().Write(buf.data(), e);
+      REQUIRE(shf::Point::Read(buf.data(), e).IsInfinity());
+      buf.back() = 1;
+      REQUIRE_THROWS_AS(shf::Point::Read(buf.data(), e),
+                        std::invalid_argument);
+    }
+    REQUIRE(shf::Point::ByteSize(Encoding::kUncompressed) >
+            shf::Point::ByteSize());
+  }
+
+  SECTION("read batch") {
+    using Encoding = shf::Point::Encoding;
+    shf::ThreadPool pool(4);
+    const std::size_t n = 50;
+    for (const auto e : {Encoding::kCompressed, Encoding::kUncompressed}) {
+      const std::size_t len = shf::Point::ByteSize(e);
+      std::vector<shf::Point> points;
+      std::vector<uint8_t> buf(n * len);
+      for (std::size_t i = 0; i < n; ++i) {
+        points.emplace_back(shf::Point::CreateRandom());
+        points[i].Write(buf.data() + i * len, e);
+      }
+
+      std::vector<shf::Point> out(n);
+      REQUIRE(shf::Point::ReadBatch(buf.data(), n, out.data(), e, &pool)
+                  .empty());
+      REQUIRE(out == points);
+
+      // bad flag, bad tag, and a coordinate that is off by one.
+      buf[3 * len] = 2;
+      buf[10 * len + 1] = 5;
+      buf[40 * len + len - 1] ^= 1;
+      if (e == Encoding::kCompressed) {
+        // x may still be on the curve with the other sign of y.
+        while (shf::Point::ReadBatch(buf.data() + 40 * len, 1, out.data(), e)
+                   .empty())
+          buf[40 * len + len - 1]++;
+      }
+      const auto errors =
+          shf::Point::ReadBatch(buf.data(), n, out.data(), e, &pool);
+      REQUIRE(errors == std::vector<std::size_t>{3, 10, 40});
+      REQUIRE(out[3].IsInfinity());
+      REQUIRE(out[4] == points[4]);
+    }
+  }
+
+  SECTION("non-canonical encoding") {
+    std::vector<uint8_t> buf(shf::Point::ByteSize());
+    buf[1] = 2;
+    // find a small valid x coordinate k.
+    dig_t k = 0;
+    while (true) {
+      buf.back() = (uint8_t)++k;
+      try {
+        shf::Point::Read(buf.data());
+        break;
+      } catch (const std::invalid_argument&) {
+        // not on the curve.
+      }
+    }
+    // k + p decodes to the same point if coordinates are reduced.
+    bn_t x;
+    bn_new(x);
+    bn_read_raw(x, fp_prime_get(), RLC_FP_DIGS);
+    bn_add_dig(x, x, k);
+    bn_write_bin(buf.data() + 2, RLC_FP_BYTES, x);
+    bn_free(x);
+    REQUIRE_THROWS_AS(shf::Point::Read(buf.data()), std::invalid_argument);
+  }
 }
 
 TEST_CASE("scalar") {
@@ -54,4 +146,187 @@ TEST_CASE("scalar") {
     shf::Scalar two = shf::Scalar::CreateFromInt(2);
     REQUIRE(a + a == two * a);
   }
+
+  SECTION("field laws") {
+    shf::Scalar a = shf::Scalar::CreateRandom();
+    shf::Scalar b = shf::Scalar::CreateRandom();
+    shf::Scalar c = shf::Scalar::CreateRandom();
+    shf::Scalar one = shf::Scalar::CreateFromInt(1);
+    REQUIRE((a * b) * c == a * (b * c));
+    REQUIRE(a * (b + c) == a * b + a * c);
+    REQUIRE(a * one == a);
+    REQUIRE((a - a).IsZero());
+    REQUIRE((-a + a).IsZero());
+    REQUIRE((-shf::Scalar()).IsZero());
+    REQUIRE(a - b == a + (-b));
+    shf::Scalar d = a;
+    d -= b;
+    REQUIRE(d == a - b);
+  }
+
+  SECTION("matches relic") {
+    bn_t n, x, y, z;
+    bn_new(n);
+    bn_new(x);
+    bn_new(y);
+    bn_new(z);
+    ec_curve_get_ord(n);
+
+    uint8_t buf[shf::Scalar::ByteSize()];
+    shf::Scalar a = shf::Scalar::CreateRandom();
+    shf::Scalar b = shf::Scalar::CreateRandom();
+    a.Write(buf);
+    bn_read_bin(x, buf, sizeof(buf));
+    b.Write(buf);
+    bn_read_bin(y, buf, sizeof(buf));
+
+    bn_mul(z, x, y);
+    bn_mod(z, z, n);
+    (a * b).Write(buf);
+    bn_read_bin(x, buf, sizeof(buf));
+    REQUIRE(bn_cmp(x, z) == RLC_EQ);
+
+    // values that are not reduced are reduced when read.
+    for (auto& v : buf) v = 0xFF;
+    bn_read_bin(x, buf, sizeof(buf));
+    bn_mod(x, x, n);
+    shf::Scalar::Read(buf).Write(buf);
+    bn_read_bin(y, buf, sizeof(buf));
+    REQUIRE(bn_cmp(x, y) == RLC_EQ);
+  }
+
+  SECTION("read write") {
+    uint8_t buf[shf::Scalar::ByteSize()];
+    shf::Scalar a = shf::Scalar::CreateRandom();
+    a.Write(buf);
+    REQUIRE(shf::Scalar::Read(buf) == a);
+    REQUIRE(shf::Scalar::ReadCanonical(buf) == a);
+  }
+
+  SECTION("canonical encoding") {
+    bn_t n;
+    bn_new(n);
+    ec_curve_get_ord(n);
+    uint8_t buf[shf::Scalar::ByteSize()];
+
+    // n - 1 is the largest canonical value.
+    bn_sub_dig(n, n, 1);
+    bn_write_bin(buf, sizeof(buf), n);
+    REQUIRE(shf::Scalar::ReadCanonical(buf) == -shf::Scalar::CreateFromInt(1));
+
+    // n + 5 is read as 5 by Read only.
+    bn_add_dig(n, n, 6);
+    bn_write_bin(buf, sizeof(buf), n);
+    REQUIRE(shf::Scalar::Read(buf) == shf::Scalar::CreateFromInt(5));
+    REQUIRE_THROWS_AS(shf::Scalar::ReadCanonical(buf), std::invalid_argument);
+    for (auto& v : buf) v = 0xFF;
+    REQUIRE_THROWS_AS(shf::Scalar::ReadCanonical(buf), std::invalid_argument);
+    bn_free(n);
+  }
+}
+
+TEST_CASE("fixed base") {
+  shf::CurveInit();
+
+  SECTION("generator") {
+    shf::Scalar x = shf::Scalar::CreateRandom();
+    REQUIRE(shf::Point::MulGenerator(x) == shf::Point::Generator() * x);
+  }
+
+  SECTION("precomputed") {
+    shf::Point p = shf::Point::CreateRandom();
+    shf::FixedBasePoint fp(p);
+    shf::Scalar x = shf::Scalar::CreateRandom();
+    REQUIRE(fp * x == p * x);
+    REQUIRE(x * fp == p * x);
+    REQUIRE(fp.Base() == p);
+    REQUIRE((fp * shf::Scalar()).IsInfinity());
+  }
+
+  SECTION("default") {
+    shf::FixedBasePoint fp;
+    REQUIRE((fp * shf::Scalar::CreateRandom()).IsInfinity());
+  }
+}
+
+TEST_CASE("normalize") {
+  shf::CurveInit();
+
+  std::vector<shf::Point> points;
+  std::vector<shf::Point> expected;
+  for (std::size_t i = 0; i < 10; ++i) {
+    const auto p = shf::Point::CreateRandom();
+    // additions leave the result in projective coordinates.
+    points.emplace_back(p + p);
+    expected.emplace_back(p + p);
+  }
+  points.emplace_back(shf::Point());
+  expected.emplace_back(shf::Point());
+
+  SECTION("batch") {
+    std::vector<shf::Point*> ptrs;
+    for (auto& p : points) ptrs.emplace_back(&p);
+    REQUIRE(!points[0].IsNormalized());
+    shf::Point::NormalizeBatch(ptrs);
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      REQUIRE(points[i].IsNormalized());
+      REQUIRE(points[i] == expected[i]);
+    }
+  }
+
+  SECTION("affine points") {
+    shf::AffinePoints affine(points);
+    REQUIRE(affine.Size() == expected.size());
+    std::size_t i = 0;
+    for (const auto& p : affine) {
+      REQUIRE(p.IsNormalized());
+      REQUIRE(p == expected[i++]);
+    }
+  }
+}
+
+TEST_CASE("storage") {
+  shf::CurveInit();
+
+  SECTION("swap") {
+    shf::Point p = shf::Point::CreateRandom();
+    shf::Point q = shf::Point::CreateRandom();
+    const shf::Point p0 = p, q0 = q;
+    swap(p, q);
+    REQUIRE(p == q0);
+    REQUIRE(q == p0);
+
+    shf::Scalar a = shf::Scalar::CreateRandom();
+    shf::Scalar b = shf::Scalar::CreateRandom();
+    const shf::Scalar a0 = a, b0 = b;
+    a.Swap(b);
+    REQUIRE(a == b0);
+    REQUIRE(b == a0);
+  }
+
+  SECTION("moves") {
+    std::vector<shf::Scalar> scalars;
+    for (std::size_t i = 0; i < 100; ++i)
+      scalars.emplace_back(shf::Scalar::CreateFromInt(i));
+    std::vector<shf::Scalar> moved = std::move(scalars);
+    for (std::size_t i = 0; i < moved.size(); ++i)
+      REQUIRE(moved[i] == shf::Scalar::CreateFromInt(i));
+    REQUIRE(std::is_nothrow_move_constructible<shf::Point>::value);
+    REQUIRE(std::is_nothrow_move_constructible<shf::Scalar>::value);
+  }
+}
+
+TEST_CASE("seeded random generator") {
+  shf::CurveInit();
+
+  const uint8_t seed[32] = {7};
+  shf::CurveSeedRandom(seed, sizeof(seed));
+  const auto a = shf::Scalar::CreateRandom();
+  shf::CurveSeedRandom(seed, sizeof(seed));
+  const auto b = shf::Scalar::CreateRandom();
+  shf::CurveReseedRandom();
+  const auto c = shf::Scalar::CreateRandom();
+
+  REQUIRE(a == b);
+  REQUIRE(a != c);
 }
@@ -1,7 +1,16 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cipher.h"
 #include "hash.h"
 
+#define ENABLE_BENCHMARKS 0
+
 static const shf::Digest SHA3_256_empty = {
     0xa7, 0xff, 0xc6, 0xf8, 0xbf, 0x1e, 0xd7, 0x66, 0x51, 0xc1, 0x47,
     0x56, 0xa0, 0x61, 0xd6, 0x62, 0xf5, 0x80, 0xff, 0x4d, 0xe4, 0x3b,
@@ -44,6 +53,16 @@ TEST_CASE("hash") {
     REQUIRE(shf::DigestEquals(hash.Finalize(), SHA3_256_0xa3_200_times));
   }
 
+  SECTION("split input") {
+    unsigned char data[100];
+    for (std::size_t i = 0; i < sizeof(data); ++i) data[i] = i * 7 + 1;
+    shf::Hash whole;
+    whole.Update(data, sizeof(data));
+    shf::Hash split;
+    split.Update(data, 3).Update(data + 3, 33).Update(data + 36, 64);
+    REQUIRE(shf::DigestEquals(whole.Finalize(), split.Finalize()));
+  }
+
   SECTION("can copy state") {
     shf::Hash hash;
     hash.Update((const unsigned char *)"abc", 3);
@@ -56,3 +75,489 @@ TEST_CASE("hash") {
     REQUIRE(!shf::DigestEquals(copy.Finalize(), SHA3_256_abc));
   }
 }
+
+TEST_CASE("hash ciphertexts") {
+  shf::CurveInit();
+
+  // more than one block, with projective points and the point at infinity.
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < 150; ++i) {
+    const auto p = shf::Point::CreateRandom();
+    const auto q = shf::Point::CreateRandom();
+    ctxts.push_back({p + q, i % 7 ? q : shf::Point()});
+  }
+  REQUIRE(!ctxts[1].U.IsNormalized());
+
+  shf::Hash one_by_one;
+  for (const auto& E : ctxts) one_by_one.Update(E.U).Update(E.V);
+  shf::Hash batched;
+  batched.Update(ctxts);
+  REQUIRE(shf::DigestEquals(one_by_one.Finalize(), batched.Finalize()));
+  REQUIRE(!ctxts[1].U.IsNormalized());
+
+  shf::Hash empty;
+  REQUIRE(shf::DigestEquals(empty.Update(std::vector<shf::Ctxt>()).Finalize(),
+                            SHA3_256_empty));
+}
+
+TEST_CASE("list digest") {
+  shf::CurveInit();
+
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < 10; ++i)
+    ctxts.push_back({shf::Point::CreateRandom(), shf::Point::CreateRandom()});
+  std::vector<uint8_t> encoded(2 * ctxts.size() * shf::Point::ByteSize());
+  std::vector<const shf::Point*> points;
+  for (const auto& E : ctxts) {
+    points.emplace_back(&E.U);
+    points.emplace_back(&E.V);
+  }
+  shf::Point::WriteBatch(points.data(), points.size(), encoded.data());
+
+  const auto digest = shf::ListDigest("a", ctxts);
+  REQUIRE(digest == shf::ListDigest("a", encoded.data(), ctxts.size()));
+  REQUIRE(digest != shf::ListDigest("b", ctxts));
+  // the length is bound, so a label cannot run into the list.
+  REQUIRE(shf::ListDigest("", {}) != shf::ListDigest("x", {}));
+  ctxts.pop_back();
+  REQUIRE(digest != shf::ListDigest("a", ctxts));
+}
+
+TEST_CASE("tree list digest") {
+  shf::CurveInit();
+
+  // more than one leaf; the ciphertexts repeat to keep the test fast.
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < 10; ++i)
+    ctxts.push_back({shf::Point::CreateRandom(), shf::Point::CreateRandom()});
+  while (ctxts.size() < 5000) ctxts.push_back(ctxts[ctxts.size() % 10]);
+  std::vector<uint8_t> encoded(2 * ctxts.size() * shf::Point::ByteSize());
+  std::vector<const shf::Point*> points;
+  for (const auto& E : ctxts) {
+    points.emplace_back(&E.U);
+    points.emplace_back(&E.V);
+  }
+  shf::Point::WriteBatch(points.data(), points.size(), encoded.data());
+
+  const auto digest = shf::TreeListDigest("a", ctxts);
+  REQUIRE(digest ==
+          shf::TreeListDigest("a", encoded.data(), ctxts.size()));
+  shf::ThreadPool pool(4);
+  REQUIRE(digest == shf::TreeListDigest("a", ctxts, &pool));
+  REQUIRE(digest ==
+          shf::TreeListDigest("a", encoded.data(), ctxts.size(), &pool));
+
+  REQUIRE(digest != shf::ListDigest("a", ctxts));
+  REQUIRE(digest != shf::TreeListDigest("b", ctxts));
+  REQUIRE(shf::TreeListDigest("", {}) != shf::TreeListDigest("x", {}));
+
+  // a change in the last leaf changes the digest.
+  auto changed = ctxts;
+  changed.back().V = shf::Point::Generator();
+  REQUIRE(digest != shf::TreeListDigest("a", changed, &pool));
+  ctxts.pop_back();
+  REQUIRE(digest != shf::TreeListDigest("a", ctxts));
+}
+
+TEST_CASE("hash many") {
+  shf::CurveInit();
+
+  // the hashes start at different positions, so their blocks fill up at
+  // different times; 13 is not a multiple of the lockstep width.
+  const std::size_t count = 13;
+  const std::size_t n = 300;
+  std::vector<uint8_t> data(count * n);
+  for (std::size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i * 7);
+  std::vector<shf::Hash> many(count);
+  std::vector<shf::Hash> one(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::vector<uint8_t> prefix(i * 11, (uint8_t)i);
+    many[i].Update(prefix.data(), prefix.size());
+    one[i].Update(prefix.data(), prefix.size());
+  }
+
+  shf::Hash::UpdateMany(many.data(), count, data.data(), n);
+  for (std::size_t i = 0; i < count; ++i) one[i].Update(data.data() + i * n, n);
+
+  std::vector<shf::Scalar> scalars(count);
+  shf::ScalarFromHashes(many.data(), count, scalars.data());
+  for (std::size_t i = 0; i < count; ++i)
+    REQUIRE(scalars[i] == shf::ScalarFromHash(one[i]));
+
+  std::vector<shf::Digest> digests(count);
+  shf::Hash::FinalizeMany(many.data(), count, digests.data());
+  for (std::size_t i = 0; i < count; ++i)
+    REQUIRE(digests[i] == one[i].Finalize());
+}
+
+TEST_CASE("sha256 backend") {
+  shf::CurveInit();
+
+  SECTION("abc") {
+    const uint8_t abc[] = {'a', 'b', 'c'};
+    const shf::Digest expected = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40,
+        0xde, 0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17,
+        0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad};
+    shf::Hash hash(shf::HashBackend::kSha256);
+    REQUIRE(hash.Update(abc, sizeof(abc)).Finalize() == expected);
+  }
+
+  SECTION("same as relic") {
+    std::vector<uint8_t> data(300);
+    for (std::size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i * 31);
+    // lengths around the block size and the padding boundary.
+    for (std::size_t n : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 300}) {
+      shf::Digest expected;
+      md_map_sh256(expected.data(), data.data(), n);
+      shf::Sha256 sha;
+      sha.Update(data.data(), n / 3);
+      sha.Update(data.data() + n / 3, n - n / 3);
+      REQUIRE(sha.Finalize() == expected);
+    }
+  }
+
+  SECTION("transcripts") {
+    const uint8_t data[] = {1, 2, 3};
+    shf::Hash keccak;
+    shf::Hash sha(shf::HashBackend::kSha256);
+    REQUIRE(sha.Backend() == shf::HashBackend::kSha256);
+    keccak.Update(data, sizeof(data));
+    sha.Update(data, sizeof(data));
+    REQUIRE(shf::ScalarFromHash(sha) != shf::ScalarFromHash(keccak));
+
+    // the output stream does not depend on how it is read.
+    const auto scalars = shf::ScalarsFromHash(sha, 3);
+    uint8_t stream[3 * shf::Scalar::WideByteSize()];
+    shf::Hash copy(sha);
+    copy.Squeeze(stream, 5);
+    copy.Squeeze(stream + 5, sizeof(stream) - 5);
+    REQUIRE(shf::Scalar::ReadWide(stream + 2 * shf::Scalar::WideByteSize()) ==
+            scalars[2]);
+
+    std::vector<shf::Hash> many(5, sha);
+    many[1] = keccak;
+    std::vector<shf::Scalar> cs(many.size());
+    shf::ScalarFromHashes(many.data(), many.size(), cs.data());
+    REQUIRE(cs[0] == shf::ScalarFromHash(sha));
+    REQUIRE(cs[1] == shf::ScalarFromHash(keccak));
+  }
+
+#if ENABLE_BENCHMARKS
+  std::vector<uint8_t> data(1 << 20, 0xa3);
+  BENCHMARK("absorb 1 MiB with Keccak") {
+    shf::Hash hash;
+    hash.Update(data.data(), data.size());
+    return hash.Finalize();
+  };
+  BENCHMARK("absorb 1 MiB with SHA-256") {
+    shf::Hash hash(shf::HashBackend::kSha256);
+    hash.Update(data.data(), data.size());
+    return hash.Finalize();
+  };
+  BENCHMARK("absorb 1 MiB with BLAKE3") {
+    shf::Hash hash(shf::HashBackend::kBlake3);
+    hash.Update(data.data(), data.size());
+    return hash.Finalize();
+  };
+  BENCHMARK("absorb 1 MiB with relic SHA-256") {
+    shf::Digest digest;
+    md_map_sh256(digest.data(), data.data(), data.size());
+    return digest;
+  };
+#endif
+}
+
+// reads a digest from hex.
+static shf::Digest DigestFromHex(const char* hex) {
+  shf::Digest digest;
+  for (std::size_t i = 0; i < digest.size(); ++i)
+    digest[i] = (uint8_t)std::stoi(std::string(hex + 2 * i, 2), nullptr, 16);
+  return digest;
+}
+
+TEST_CASE("blake3 backend") {
+  shf::CurveInit();
+
+  // the input of the official test vectors: byte i is i mod 251.
+  std::vector<uint8_t> data(102400);
+  for (std::size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i % 251);
+
+  SECTION("known answers") {
+    // lengths around the block size, the chunk size of 1 KiB and the merges
+    // of the tree.
+    const std::pair<std::size_t, const char*> vectors[] = {
+        {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+        {63,
+         "e9bc37a594daad83be9470df7f7b3798297c3d834ce80ba85d6e207627b7db7b"},
+        {64,
+         "4eed7141ea4a5cd4b788606bd23f46e212af9cacebacdc7d1f4c6dc7f2511b98"},
+        {65,
+         "de1e5fa0be70df6d2be8fffd0e99ceaa8eb6e8c93a63f2d8d1c30ecb6b263dee"},
+        {1023,
+         "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11"},
+        {1024,
+         "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+        {1025,
+         "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+        {2048,
+         "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a"},
+        {2049,
+         "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030"},
+        {3072,
+         "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2"},
+        {3073,
+         "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3"},
+        {4096,
+         "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969"},
+        {4097,
+         "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995"},
+        {8193,
+         "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"},
+        {16385,
+         "1dabe216be2578830263b049de1639f39f05a4da616b9b78c7a5e4e41662fd1f"},
+        {102400,
+         "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"}};
+    for (const auto& v : vectors) {
+      const std::size_t n = v.first;
+      shf::Blake3 blake;
+      blake.Update(data.data(), n / 3);
+      blake.Update(data.data() + n / 3, n - n / 3);
+      REQUIRE(blake.Finalize() == DigestFromHex(v.second));
+
+      shf::Hash hash(shf::HashBackend::kBlake3);
+      REQUIRE(hash.Update(data.data(), n).Finalize() ==
+              DigestFromHex(v.second));
+    }
+  }
+
+  SECTION("extended output") {
+    const char* expected =
+        "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"
+        "f4c4a22b4b399155358a994e52bf255de60035742ec71bd08ac275a1b51cc6bf"
+        "e332b0ef84b409108cda080e6269ed4b3e2c3f7d722aa4cdc98d16deb554e562"
+        "7be8f955c98e1d5f9565a9194cad0c4285f93700062d9595adb992ae68ff1280";
+    shf::Blake3 blake;
+    blake.Update(data.data(), 1025);
+    uint8_t out[128];
+    blake.Squeeze(out, 1);
+    blake.Squeeze(out + 1, 70);
+    blake.Squeeze(out + 71, sizeof(out) - 71);
+    for (std::size_t i = 0; i < sizeof(out); i += 32) {
+      shf::Digest part;
+      std::copy(out + i, out + i + 32, part.begin());
+      REQUIRE(part == DigestFromHex(expected + 2 * i));
+    }
+
+    // Hash skips the first block, which holds the digest.
+    shf::Hash hash(shf::HashBackend::kBlake3);
+    hash.Update(data.data(), 1025);
+    uint8_t squeezed[64];
+    hash.Squeeze(squeezed, sizeof(squeezed));
+    REQUIRE(std::equal(squeezed, squeezed + sizeof(squeezed), out + 64));
+  }
+
+  SECTION("transcripts") {
+    shf::Hash keccak;
+    shf::Hash sha(shf::HashBackend::kSha256);
+    shf::Hash blake(shf::HashBackend::kBlake3);
+    REQUIRE(blake.Backend() == shf::HashBackend::kBlake3);
+    keccak.Update(data.data(), 3);
+    sha.Update(data.data(), 3);
+    blake.Update(data.data(), 3);
+    const auto c = shf::ScalarFromHash(blake);
+    REQUIRE(c != shf::ScalarFromHash(keccak));
+    REQUIRE(c != shf::ScalarFromHash(sha));
+
+    std::vector<shf::Hash> many(3, blake);
+    many[1] = keccak;
+    std::vector<shf::Scalar> cs(many.size());
+    shf::ScalarFromHashes(many.data(), many.size(), cs.data());
+    REQUIRE(cs[0] == c);
+    REQUIRE(cs[1] == shf::ScalarFromHash(keccak));
+    REQUIRE(cs[2] == c);
+
+    // UpdateMany and FinalizeMany leave BLAKE3 hashes to Update and Finalize.
+    std::vector<shf::Hash> hashes(3, shf::Hash(shf::HashBackend::kBlake3));
+    shf::Hash::UpdateMany(hashes.data(), hashes.size(), data.data(), 1000);
+    std::vector<shf::Digest> digests(hashes.size());
+    shf::Hash::FinalizeMany(hashes.data(), hashes.size(), digests.data());
+    for (std::size_t i = 0; i < hashes.size(); ++i) {
+      shf::Blake3 one;
+      one.Update(data.data() + 1000 * i, 1000);
+      REQUIRE(digests[i] == one.Finalize());
+    }
+  }
+}
+
+static const uint8_t SHAKE256_empty[32] = {
+    0x46, 0xb9, 0xdd, 0x2b, 0x0b, 0xa8, 0x8d, 0x13, 0x23, 0x3b, 0x3f,
+    0xeb, 0x74, 0x3e, 0xeb, 0x24, 0x3f, 0xcd, 0x52, 0xea, 0x62, 0xb8,
+    0x1b, 0x82, 0xb5, 0x0c, 0x27, 0x64, 0x6e, 0xd5, 0x76, 0x2f};
+
+TEST_CASE("squeeze") {
+  shf::CurveInit();
+
+  SECTION("SHAKE256 empty") {
+    shf::Hash hash;
+    uint8_t out[32];
+    hash.Squeeze(out, sizeof(out));
+    REQUIRE(std::equal(out, out + sizeof(out), SHAKE256_empty));
+  }
+
+  SECTION("output stream") {
+    shf::Hash a;
+    a.Update((const unsigned char *)"abc", 3);
+    shf::Hash b = a;
+    // more than one block of output.
+    uint8_t whole[300];
+    a.Squeeze(whole, sizeof(whole));
+    uint8_t parts[300];
+    b.Squeeze(parts, 1);
+    b.Squeeze(parts + 1, 135);
+    b.Squeeze(parts + 136, 164);
+    REQUIRE(std::equal(whole, whole + sizeof(whole), parts));
+  }
+
+  SECTION("scalars") {
+    shf::Hash hash;
+    hash.Update((const unsigned char *)"abc", 3);
+    const auto scalars = shf::ScalarsFromHash(hash, 5);
+    REQUIRE(scalars.size() == 5);
+    REQUIRE(scalars[0] != scalars[1]);
+    // the hash is left as it is.
+    REQUIRE(shf::ScalarsFromHash(hash, 5) == scalars);
+    REQUIRE(shf::ScalarsFromHash(hash, 2)[1] == scalars[1]);
+
+    uint8_t wide[64];
+    shf::Hash copy = hash;
+    copy.Squeeze(wide, sizeof(wide));
+    REQUIRE(shf::Scalar::ReadWide(wide) == scalars[0]);
+  }
+
+  SECTION("wide reduction") {
+    uint8_t wide[64] = {0};
+    for (std::size_t i = 32; i < 64; ++i) wide[i] = (uint8_t)(i * 5);
+    REQUIRE(shf::Scalar::ReadWide(wide) == shf::Scalar::Read(wide + 32));
+
+    // 2^256 = (2^256 - 1) + 1.
+    uint8_t ones[32];
+    std::fill(ones, ones + 32, 0xff);
+    const auto two256 =
+        shf::Scalar::Read(ones) + shf::Scalar::CreateFromInt(1);
+    wide[31] = 3;
+    REQUIRE(shf::Scalar::ReadWide(wide) ==
+            shf::Scalar::CreateFromInt(3) * two256 +
+                shf::Scalar::Read(wide + 32));
+  }
+}
+
+// the straightforward implementation of Keccak-f[1600], to check the
+// optimized one against.
+static void ReferenceKeccakF(uint64_t state[25]) {
+  static const uint64_t rc[24] = {
+      0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+      0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+      0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+      0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+      0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+      0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+      0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+      0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+  static const unsigned int rotc[24] = {1,  3,  6,  10, 15, 21, 28, 36,
+                                        45, 55, 2,  14, 27, 41, 56, 8,
+                                        25, 43, 62, 18, 39, 61, 20, 44};
+  static const unsigned int piln[24] = {10, 7,  11, 17, 18, 3,  5,  16,
+                                        8,  21, 24, 4,  15, 23, 19, 13,
+                                        12, 2,  20, 14, 22, 9,  6,  1};
+  const auto rotl = [](uint64_t x, unsigned int y) {
+    return (x << y) | (x >> (64 - y));
+  };
+
+  uint64_t t, bc[5];
+  for (std::size_t round = 0; round < 24; ++round) {
+    for (std::size_t i = 0; i < 5; ++i)
+      bc[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^
+              state[i + 20];
+    for (std::size_t i = 0; i < 5; ++i) {
+      t = bc[(i + 4) % 5] ^ rotl(bc[(i + 1) % 5], 1);
+      for (std::size_t j = 0; j < 25; j += 5) state[j + i] ^= t;
+    }
+    t = state[1];
+    for (std::size_t i = 0; i < 24; ++i) {
+      bc[0] = state[piln[i]];
+      state[piln[i]] = rotl(t, rotc[i]);
+      t = bc[0];
+    }
+    for (std::size_t j = 0; j < 25; j += 5) {
+      for (std::size_t i = 0; i < 5; ++i) bc[i] = state[j + i];
+      for (std::size_t i = 0; i < 5; ++i)
+        state[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+    }
+    state[0] ^= rc[round];
+  }
+}
+
+TEST_CASE("keccak permutation") {
+  uint64_t state[25];
+  uint64_t expected[25];
+  uint64_t v = 0x0123456789abcdefULL;
+  for (std::size_t i = 0; i < 25; ++i) {
+    v = v * 6364136223846793005ULL + 1442695040888963407ULL;
+    state[i] = expected[i] = v;
+  }
+  for (std::size_t i = 0; i < 3; ++i) {
+    shf::KeccakF1600(state);
+    ReferenceKeccakF(expected);
+    REQUIRE(std::equal(state, state + 25, expected));
+  }
+
+  SECTION("scalar") {
+    // KeccakF1600 may use vector instructions, this is the fallback.
+    uint64_t scalar[25];
+    std::copy(state, state + 25, scalar);
+    shf::KeccakF1600Scalar(scalar);
+    ReferenceKeccakF(expected);
+    REQUIRE(std::equal(scalar, scalar + 25, expected));
+  }
+
+  SECTION("lockstep") {
+    uint64_t many[8][25];
+    uint64_t* states[8];
+    for (std::size_t j = 0; j < 8; ++j) {
+      for (std::size_t i = 0; i < 25; ++i) many[j][i] = state[i] + j * i;
+      states[j] = many[j];
+    }
+    shf::KeccakF1600x8(states);
+    shf::KeccakF1600x4(states + 2);
+    for (std::size_t j = 0; j < 8; ++j) {
+      for (std::size_t i = 0; i < 25; ++i) expected[i] = state[i] + j * i;
+      ReferenceKeccakF(expected);
+      if (j >= 2 && j < 6) ReferenceKeccakF(expected);
+      REQUIRE(std::equal(many[j], many[j] + 25, expected));
+    }
+  }
+
+#if ENABLE_BENCHMARKS
+  BENCHMARK("reference permutation") {
+    ReferenceKeccakF(expected);
+    return expected[0];
+  };
+  BENCHMARK("permutation") {
+    shf::KeccakF1600(state);
+    return state[0];
+  };
+  BENCHMARK("scalar permutation") {
+    shf::KeccakF1600Scalar(state);
+    return state[0];
+  };
+
+  std::vector<uint8_t> data(1 << 20, 0xa3);
+  BENCHMARK("absorb 1 MiB") {
+    shf::Hash hash;
+    hash.Update(data.data(), data.size());
+    return hash.Finalize();
+  };
+#endif
+}
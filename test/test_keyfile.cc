@@ -0,0 +1,232 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "keyfile.h"
+#include "precompute.h"
+#include "shuffler.h"
+
+static inline std::string TempPath(const std::string& name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// flip one byte at an offset from the start of a file.
+static inline void Corrupt(const std::string& path, std::size_t offset) {
+  std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+  f.seekg(offset);
+  char c;
+  f.get(c);
+  f.seekp(offset);
+  f.put(c ^ 1);
+}
+
+// flip one byte of the points of a key file and fix up the checksum in its
+// header, as someone who can write the file could.
+static inline void Forge(const std::string& path, std::size_t offset) {
+  // the checksum follows the magic, version, kind, sizes and layout.
+  const std::size_t checksum_at = 8 + 4 + 4 + 8 + 8 + RLC_MD_LEN;
+  const std::size_t header_size = checksum_at + RLC_MD_LEN;
+  Corrupt(path, header_size + offset);
+
+  std::ifstream in(path, std::ios::binary);
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+  in.close();
+  // the payload is smaller than one checksum chunk.
+  uint8_t chunk[RLC_MD_LEN];
+  md_map(chunk, bytes.data() + header_size, bytes.size() - header_size);
+  md_map(bytes.data() + checksum_at, chunk, sizeof(chunk));
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+TEST_CASE("key files") {
+  shf::CurveInit();
+
+  const std::string path = TempPath("shf_test_commit_key.bin");
+  const std::size_t n = 100;
+  const auto ck = shf::CreateCommitKey(n);
+  shf::WriteCommitKey(path, ck);
+
+  SECTION("commit key round trip") {
+    shf::ThreadPool pool(2);
+    const auto read = shf::ReadCommitKey(path, &pool);
+    REQUIRE(read.Size() == n);
+    REQUIRE(read.H.Base() == ck.H.Base());
+    for (std::size_t i = 0; i < n; ++i) {
+      REQUIRE(read.G[i] == ck.G[i]);
+      REQUIRE(read.G[i].IsNormalized());
+    }
+
+    std::vector<shf::Scalar> m;
+    for (std::size_t i = 0; i < n; ++i)
+      m.emplace_back(shf::Scalar::CreateRandom());
+    const auto r = shf::Scalar::CreateRandom();
+    REQUIRE(shf::Commit(read, r, m) == shf::Commit(ck, r, m));
+
+    // the mapping outlives the key it was read into.
+    const shf::CommitKey copy = read;
+    REQUIRE(copy.G[n - 1] == ck.G[n - 1]);
+  }
+
+  SECTION("digest") {
+    const std::string other = TempPath("shf_test_commit_key2.bin");
+    shf::WriteCommitKey(other, shf::ReadCommitKey(path));
+    REQUIRE(shf::DigestEquals(shf::KeyFileDigest(path),
+                              shf::KeyFileDigest(other)));
+    std::remove(other.c_str());
+  }
+
+  SECTION("expected digest") {
+    const auto digest = shf::KeyFileDigest(path);
+    REQUIRE(shf::ReadCommitKey(path, nullptr, &digest).Size() == n);
+
+    shf::Digest other = digest;
+    other[0] ^= 1;
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path, nullptr, &other),
+                      std::runtime_error);
+
+    // a file with a recomputed checksum no longer matches.
+    Forge(path, shf::Point::RawSize());
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path, nullptr, &digest),
+                      std::runtime_error);
+  }
+
+  SECTION("point not on the curve") {
+    // the x coordinate of G[0].
+    Forge(path, shf::Point::RawSize());
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path), std::runtime_error);
+  }
+
+  SECTION("point not affine") {
+    // the z coordinate of G[0].
+    Forge(path, shf::Point::RawSize() + 2 * RLC_FP_DIGS * sizeof(dig_t));
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path), std::runtime_error);
+  }
+
+  SECTION("corrupted points") {
+    Corrupt(path, 200);
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path), std::runtime_error);
+  }
+
+  SECTION("corrupted header") {
+    // the version field follows the magic.
+    Corrupt(path, 8);
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path), std::runtime_error);
+  }
+
+  SECTION("truncated") {
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(path), std::runtime_error);
+  }
+
+  SECTION("public key") {
+    const std::string pk_path = TempPath("shf_test_public_key.bin");
+    const auto pk = shf::CreatePublicKey(shf::CreateSecretKey());
+    shf::WritePublicKey(pk_path, pk);
+    REQUIRE(shf::ReadPublicKey(pk_path) == pk);
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(pk_path), std::runtime_error);
+    REQUIRE_THROWS_AS(shf::ReadPublicKey(path), std::runtime_error);
+    std::remove(pk_path.c_str());
+  }
+
+  SECTION("missing file") {
+    REQUIRE_THROWS_AS(shf::ReadCommitKey(TempPath("shf_does_not_exist")),
+                      std::runtime_error);
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("precompute cache") {
+  shf::CurveInit();
+
+  const auto dir = std::filesystem::temp_directory_path() / "shf_test_cache";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directory(dir);
+  const shf::PrecomputeCache cache(dir.string());
+
+  const auto base = shf::Point::CreateRandom();
+  const auto x = shf::Scalar::CreateRandom();
+
+  SECTION("fixed base") {
+    const auto built = cache.FixedBase(base);
+    REQUIRE(!std::filesystem::is_empty(dir));
+    const auto loaded = cache.FixedBase(base);
+    REQUIRE(loaded.Table() != built.Table());
+    REQUIRE(loaded * x == base * x);
+    for (std::size_t i = 0; i < shf::FixedBasePoint::TableSize(); ++i)
+      REQUIRE(loaded.Table()[i] == built.Table()[i]);
+
+    // a corrupted file is recomputed.
+    for (const auto& f : std::filesystem::directory_iterator(dir))
+      std::filesystem::resize_file(f.path(), 10);
+    REQUIRE(cache.FixedBase(base) * x == base * x);
+    REQUIRE(cache.FixedBase(base) * x == base * x);
+  }
+
+  SECTION("commit key") {
+    const uint8_t seed[] = {7, 7, 7};
+    const std::size_t n = 20;
+    const auto expected = shf::CreateCommitKey(n, seed, sizeof(seed));
+    for (int i = 0; i < 2; ++i) {
+      const auto ck = cache.CommitKeyFromSeed(n, seed, sizeof(seed));
+      REQUIRE(ck.Size() == n);
+      REQUIRE(ck.H * x == expected.H * x);
+      for (std::size_t j = 0; j < n; ++j) REQUIRE(ck.G[j] == expected.G[j]);
+    }
+    // other sizes do not share files.
+    REQUIRE(cache.CommitKeyFromSeed(n / 2, seed, sizeof(seed)).Size() == n / 2);
+  }
+
+  SECTION("planted commit key") {
+    const uint8_t seed[] = {9};
+    const std::size_t n = 20;
+    const auto expected = shf::CreateCommitKey(n, seed, sizeof(seed));
+    cache.CommitKeyFromSeed(n, seed, sizeof(seed));
+
+    // replace the cached key by one with the right H and known generators.
+    shf::CommitKey planted = shf::CreateCommitKey(n);
+    planted.H = expected.H;
+    for (const auto& f : std::filesystem::directory_iterator(dir))
+      if (f.path().filename().string().rfind("commit-key", 0) == 0)
+        shf::WriteCommitKey(f.path().string(), planted);
+
+    const auto ck = cache.CommitKeyFromSeed(n, seed, sizeof(seed));
+    for (std::size_t j = 0; j < n; ++j) REQUIRE(ck.G[j] == expected.G[j]);
+  }
+
+  SECTION("directory writable by others") {
+    std::filesystem::permissions(dir, std::filesystem::perms::others_write,
+                                 std::filesystem::perm_options::add);
+    REQUIRE(cache.FixedBase(base) * x == base * x);
+    REQUIRE(std::filesystem::is_empty(dir));
+  }
+
+  SECTION("shuffle with cached tables") {
+    const uint8_t seed[] = {1};
+    const std::size_t n = 8;
+    const auto sk = shf::CreateSecretKey();
+    const auto pk = shf::CreatePublicKey(sk);
+    const auto ck = cache.CommitKeyFromSeed(n, seed, sizeof(seed));
+
+    std::vector<shf::Ctxt> ctxts;
+    for (std::size_t i = 0; i < n; ++i)
+      ctxts.emplace_back(shf::Encrypt(pk, shf::Point::CreateRandom()));
+    shf::Prg prg;
+    shf::Shuffler shuffler(cache.FixedBase(pk), ck, prg);
+    shf::Hash hp, hv;
+    const auto proof = shuffler.Shuffle(ctxts, hp);
+    REQUIRE(shuffler.VerifyShuffle(ctxts, proof, hv));
+  }
+
+  SECTION("unwritable directory") {
+    const shf::PrecomputeCache missing((dir / "does-not-exist").string());
+    REQUIRE(missing.FixedBase(base) * x == base * x);
+  }
+
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,84 @@
+#include <catch2/catch.hpp>
+#include <vector>
+
+#include "multiexp.h"
+
+static inline shf::Point NaiveMultiExp(const std::vector<shf::Scalar>& scalars,
+                                       const std::vector<shf::Point>& points) {
+  shf::Point r;
+  for (std::size_t i = 0; i < scalars.size(); ++i) r += scalars[i] * points[i];
+  return r;
+}
+
+TEST_CASE("multiexp engine") {
+  shf::CurveInit();
+
+  SECTION("matches naive computation") {
+    // sizes on both sides of the Straus/Pippenger cutoff.
+    for (std::size_t n : {0, 1, 2, 7, 31, 32, 33, 150}) {
+      std::vector<shf::Scalar> scalars;
+      std::vector<shf::Point> points;
+      for (std::size_t i = 0; i < n; ++i) {
+        scalars.emplace_back(shf::Scalar::CreateRandom());
+        points.emplace_back(shf::Point::CreateRandom());
+      }
+      REQUIRE(shf::MultiExp(scalars, points) == NaiveMultiExp(scalars, points));
+    }
+  }
+
+  SECTION("zero scalars, infinity and repeated points") {
+    const std::size_t n = 40;
+    const auto P = shf::Point::CreateRandom();
+    std::vector<shf::Scalar> scalars;
+    std::vector<shf::Point> points;
+    for (std::size_t i = 0; i < n; ++i) {
+      scalars.emplace_back(i % 3 ? shf::Scalar::CreateRandom() : shf::Scalar());
+      points.emplace_back(i % 5 ? P : shf::Point());
+    }
+    REQUIRE(shf::MultiExp(scalars, points) == NaiveMultiExp(scalars, points));
+  }
+
+  SECTION("uses a prefix of the points") {
+    std::vector<shf::Scalar> scalars = {shf::Scalar::CreateRandom()};
+    std::vector<shf::Point> points = {shf::Point::CreateRandom(),
+                                      shf::Point::CreateRandom()};
+    REQUIRE(shf::MultiExp(scalars, points) == scalars[0] * points[0]);
+    REQUIRE_THROWS(shf::MultiExp({scalars[0], scalars[0], scalars[0]}, points));
+  }
+
+  SECTION("batch merges terms on the same base") {
+    const std::size_t n = 50;
+    std::vector<shf::Point> points;
+    for (std::size_t i = 0; i < n; ++i)
+      points.emplace_back(shf::Point::CreateRandom());
+
+    // every base shows up twice, once in each batch.
+    shf::MultiExpBatch b0, b1;
+    std::vector<shf::Scalar> scalars(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      const auto s0 = shf::Scalar::CreateRandom();
+      const auto s1 = shf::Scalar::CreateRandom();
+      b0.Add(s0, points[i]);
+      b1.Add(s1, points[i]);
+      scalars[i] = s0 + s1;
+    }
+    b0.Add(b1);
+    REQUIRE(b0.Size() == n);
+    REQUIRE(b0.Evaluate() == NaiveMultiExp(scalars, points));
+
+    shf::ThreadPool pool(4);
+    REQUIRE(b0.Evaluate(&pool) == NaiveMultiExp(scalars, points));
+    REQUIRE(shf::MultiExpBatch().Evaluate().IsInfinity());
+  }
+
+  SECTION("batch weights") {
+    // every batch has its own seed, and later weights continue its stream.
+    shf::MultiExpBatch b0, b1;
+    const auto w0 = b0.Weights(3);
+    const auto w1 = b1.Weights(3);
+    REQUIRE(w0.size() == 3);
+    REQUIRE(w0 != w1);
+    REQUIRE(w0[0] != w0[1]);
+    REQUIRE(b0.Weights(1)[0] != w0[2]);
+  }
+}
@@ -0,0 +1,216 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "serialize.h"
+#include "shuffler.h"
+#include "threadpool.h"
+
+TEST_CASE("serialize shuffle proof") {
+  shf::CurveInit();
+
+  const std::size_t n = 20;
+  const auto ck = shf::CreateCommitKey(n);
+  const auto sk = shf::CreateSecretKey();
+  const auto pk = shf::CreatePublicKey(sk);
+
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < n; ++i)
+    ctxts.emplace_back(shf::Encrypt(pk, shf::Point::CreateRandom()));
+
+  shf::Prg prg;
+  shf::Shuffler shuffler(pk, ck, prg);
+  shf::Hash hp;
+  const auto proof = shuffler.Shuffle(ctxts, hp);
+
+  std::vector<uint8_t> bytes = {0xaa};
+  shf::ThreadPool pool(4);
+  shf::Serialize(proof, bytes, &pool);
+  REQUIRE(bytes.size() == 1 + shf::SerializedSize(proof));
+  REQUIRE(bytes[0] == 0xaa);
+
+  const shf::ShuffleProofView view(bytes.data() + 1, bytes.size() - 1);
+
+  SECTION("lazy fields") {
+    REQUIRE(view.Size() == n);
+    REQUIRE(view.Backend() == shf::HashBackend::kKeccak);
+    REQUIRE(view.ProductSize() == proof.product_proof.as.size());
+    REQUIRE(view.MultiExpSize() == proof.multiexp_proof.a.size());
+    REQUIRE(view.Permuted(3).U == proof.permuted[3].U);
+    REQUIRE(view.Permuted(n - 1).V == proof.permuted[n - 1].V);
+    REQUIRE(view.Ca() == proof.Ca);
+    REQUIRE(view.Cb() == proof.Cb);
+    REQUIRE(view.ProductA(5) == proof.product_proof.as[5]);
+    REQUIRE(view.ProductB(0) == proof.product_proof.bs[0]);
+    REQUIRE(view.MultiExpA(n - 1) == proof.multiexp_proof.a[n - 1]);
+
+    std::vector<uint8_t> U(shf::Point::ByteSize());
+    proof.permuted[1].U.Write(U.data());
+    REQUIRE(std::equal(U.begin(), U.end(),
+                       view.PermutedBytes() + 2 * shf::Point::ByteSize()));
+  }
+
+  SECTION("decode and verify") {
+    const auto decoded = view.ToProof(&pool);
+    std::vector<uint8_t> again;
+    shf::Serialize(decoded, again);
+    REQUIRE(std::equal(again.begin(), again.end(), bytes.begin() + 1));
+
+    shf::Hash hv;
+    REQUIRE(shuffler.VerifyShuffle(ctxts, decoded, hv));
+  }
+
+  SECTION("malformed") {
+    const auto* data = bytes.data() + 1;
+    const std::size_t size = bytes.size() - 1;
+    REQUIRE_THROWS_AS(shf::ShuffleProofView(data, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(shf::ShuffleProofView(data, size - 1),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(shf::ShuffleProofView(data + 1, size - 1),
+                      std::invalid_argument);
+
+    std::vector<uint8_t> longer(data, data + size);
+    longer.push_back(0);
+    REQUIRE_THROWS_AS(shf::ShuffleProofView(longer.data(), longer.size()),
+                      std::invalid_argument);
+
+    // a huge list length must not wrap around.
+    std::vector<uint8_t> huge(data, data + size);
+    for (std::size_t i = 2; i < 10; ++i) huge[i] = 0xff;
+    REQUIRE_THROWS_AS(shf::ShuffleProofView(huge.data(), huge.size()),
+                      std::invalid_argument);
+
+    // a scalar s + n would be read as s by Scalar::Read, which gives the
+    // proof a second encoding. r is made small so that r + n fits.
+    auto small = proof;
+    small.product_proof.r = shf::Scalar::CreateFromInt(5);
+    std::vector<uint8_t> unreduced;
+    shf::Serialize(small, unreduced);
+    uint8_t r[shf::Scalar::ByteSize()];
+    small.product_proof.r.Write(r);
+    const auto at =
+        std::search(unreduced.begin(), unreduced.end(), r, r + sizeof(r));
+    REQUIRE(at != unreduced.end());
+    REQUIRE(shf::ShuffleProofView(unreduced.data(), unreduced.size())
+                .ProductProof()
+                .r == small.product_proof.r);
+    bn_t n;
+    bn_new(n);
+    ec_curve_get_ord(n);
+    bn_add_dig(n, n, 5);
+    bn_write_bin(r, sizeof(r), n);
+    bn_free(n);
+    std::copy(r, r + sizeof(r), at);
+    REQUIRE(shf::Scalar::Read(r) == small.product_proof.r);
+    const shf::ShuffleProofView bad(unreduced.data(), unreduced.size());
+    REQUIRE_THROWS_AS(bad.ProductProof(), std::invalid_argument);
+    REQUIRE_THROWS_AS(bad.ToProof(), std::invalid_argument);
+
+    std::vector<uint8_t> backend(data, data + size);
+    backend[1] = 0xff;
+    REQUIRE_THROWS_AS(shf::ShuffleProofView(backend.data(), backend.size()),
+                      std::invalid_argument);
+  }
+}
+
+TEST_CASE("verify shuffle from bytes") {
+  shf::CurveInit();
+
+  const std::size_t n = 20;
+  const auto ck = shf::CreateCommitKey(n);
+  const auto pk = shf::CreatePublicKey(shf::CreateSecretKey());
+
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < n; ++i)
+    ctxts.emplace_back(shf::Encrypt(pk, shf::Point::CreateRandom()));
+  std::vector<uint8_t> encoded(2 * n * shf::Point::ByteSize());
+  shf::WriteCiphertexts(ctxts, encoded.data());
+
+  shf::Prg prg;
+  shf::ThreadPool pool(4);
+  shf::Shuffler shuffler(pk, ck, prg, pool);
+  shf::Hash hp;
+  const auto proof = shuffler.Shuffle(ctxts, hp);
+  std::vector<uint8_t> bytes;
+  shf::Serialize(proof, bytes);
+  const shf::ShuffleProofView view(bytes.data(), bytes.size());
+
+  shf::Hash hv;
+  REQUIRE(shuffler.VerifyShuffle(encoded.data(), n, view, hv));
+
+  // the transcript ends up in the same state as when verifying decoded values.
+  shf::Hash hd;
+  REQUIRE(shuffler.VerifyShuffle(ctxts, proof, hd));
+  REQUIRE(hv.Finalize() == hd.Finalize());
+
+  SECTION("wrong size") {
+    shf::Hash h;
+    REQUIRE_FALSE(shuffler.VerifyShuffle(encoded.data(), n - 1, view, h));
+  }
+
+  SECTION("uncompressed input") {
+    const auto encoding = shf::Point::Encoding::kUncompressed;
+    std::vector<uint8_t> wide(2 * n * shf::Point::ByteSize(encoding));
+    shf::WriteCiphertexts(ctxts, wide.data(), nullptr, encoding);
+    shf::Hash h;
+    REQUIRE_FALSE(shuffler.VerifyShuffle(wide.data(), n, view, h));
+  }
+
+  SECTION("tampered input") {
+    encoded[1] ^= 1;
+    shf::Hash h;
+    REQUIRE_FALSE(shuffler.VerifyShuffle(encoded.data(), n, view, h));
+  }
+
+  SECTION("tampered proof") {
+    // flip a bit in the encoding of Cb.
+    bytes[view.CbBytes() - bytes.data() + 5] ^= 1;
+    shf::Hash h;
+    REQUIRE_FALSE(shuffler.VerifyShuffle(encoded.data(), n, view, h));
+  }
+
+  SECTION("sha256 transcript") {
+    shf::Hash hs(shf::HashBackend::kSha256);
+    const auto sha_proof = shuffler.Shuffle(ctxts, hs);
+    std::vector<uint8_t> sha_bytes;
+    shf::Serialize(sha_proof, sha_bytes);
+    const shf::ShuffleProofView sha_view(sha_bytes.data(), sha_bytes.size());
+    REQUIRE(sha_view.Backend() == shf::HashBackend::kSha256);
+    REQUIRE(sha_view.ToProof().hash_backend == shf::HashBackend::kSha256);
+
+    shf::Hash h(shf::HashBackend::kSha256);
+    REQUIRE(shuffler.VerifyShuffle(encoded.data(), n, sha_view, h));
+    shf::Hash hk;
+    REQUIRE_FALSE(shuffler.VerifyShuffle(encoded.data(), n, sha_view, hk));
+  }
+
+  SECTION("blake3 transcript") {
+    shf::Hash hb(shf::HashBackend::kBlake3);
+    const auto blake_proof = shuffler.Shuffle(ctxts, hb);
+    std::vector<uint8_t> blake_bytes;
+    shf::Serialize(blake_proof, blake_bytes);
+    const shf::ShuffleProofView blake_view(blake_bytes.data(),
+                                           blake_bytes.size());
+    REQUIRE(blake_view.Backend() == shf::HashBackend::kBlake3);
+
+    shf::Hash h(shf::HashBackend::kBlake3);
+    REQUIRE(shuffler.VerifyShuffle(encoded.data(), n, blake_view, h));
+    shf::Hash hs(shf::HashBackend::kSha256);
+    REQUIRE_FALSE(shuffler.VerifyShuffle(encoded.data(), n, blake_view, hs));
+  }
+
+  SECTION("tree hashing") {
+    shuffler.SetListHashing(shf::ListHashing::kTree);
+    shf::Hash ht;
+    const auto tree_proof = shuffler.Shuffle(ctxts, ht);
+    std::vector<uint8_t> tree_bytes;
+    shf::Serialize(tree_proof, tree_bytes);
+    const shf::ShuffleProofView tree_view(tree_bytes.data(),
+                                          tree_bytes.size());
+    shf::Hash h;
+    REQUIRE(shuffler.VerifyShuffle(encoded.data(), n, tree_view, h));
+    shf::Hash hs;
+    REQUIRE_FALSE(shuffler.VerifyShuffle(encoded.data(), n, view, hs));
+  }
+}
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "shuffler.h"
+#include "threadpool.h"
 
 #define ENABLE_BENCHMARKS 0
 
@@ -62,3 +63,174 @@ TEST_CASE("shuffle") {
 #endif
   REQUIRE(correct);
 }
+
+// puts the random generator back on a system seed when a test that fixed it
+// is done, even if it fails.
+struct ReseedOnExit {
+  ~ReseedOnExit() { shf::CurveReseedRandom(); }
+};
+
+TEST_CASE("shuffle with thread pool") {
+  shf::CurveInit();
+  ReseedOnExit reseed;
+
+  const std::size_t n = 50;
+  const auto ck = shf::CreateCommitKey(n);
+  const auto sk = shf::CreateSecretKey();
+  const auto pk = shf::CreatePublicKey(sk);
+
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < n; ++i)
+    ctxts.emplace_back(shf::Encrypt(pk, shf::Point::CreateRandom()));
+
+  const uint8_t seed[shf::Prg::SeedSize()] = {1, 2, 3};
+
+  // same random generator state for both runs.
+  shf::CurveSeedRandom(seed, sizeof(seed));
+  shf::Prg prg0(seed);
+  shf::Shuffler sequential(pk, ck, prg0);
+  shf::Hash h0;
+  const auto p0 = sequential.Shuffle(ctxts, h0);
+
+  shf::CurveSeedRandom(seed, sizeof(seed));
+  shf::Prg prg1(seed);
+  shf::ThreadPool pool(4);
+  shf::Shuffler parallel(pk, ck, prg1, pool);
+  shf::Hash h1;
+  const auto p1 = parallel.Shuffle(ctxts, h1);
+
+  REQUIRE(p0.permuted.size() == p1.permuted.size());
+  for (std::size_t i = 0; i < n; ++i) {
+    REQUIRE(p0.permuted[i].U == p1.permuted[i].U);
+    REQUIRE(p0.permuted[i].V == p1.permuted[i].V);
+  }
+  REQUIRE(p0.Ca == p1.Ca);
+  REQUIRE(p0.Cb == p1.Cb);
+
+  const auto& q0 = p0.product_proof;
+  const auto& q1 = p1.product_proof;
+  REQUIRE(q0.C0 == q1.C0);
+  REQUIRE(q0.C1 == q1.C1);
+  REQUIRE(q0.C2 == q1.C2);
+  REQUIRE(q0.as == q1.as);
+  REQUIRE(q0.bs == q1.bs);
+  REQUIRE(q0.r == q1.r);
+  REQUIRE(q0.s == q1.s);
+
+  const auto& m0 = p0.multiexp_proof;
+  const auto& m1 = p1.multiexp_proof;
+  REQUIRE(m0.C0 == m1.C0);
+  REQUIRE(m0.C1 == m1.C1);
+  REQUIRE(m0.E.U == m1.E.U);
+  REQUIRE(m0.E.V == m1.E.V);
+  REQUIRE(m0.a == m1.a);
+  REQUIRE(m0.r == m1.r);
+  REQUIRE(m0.b == m1.b);
+  REQUIRE(m0.s == m1.s);
+  REQUIRE(m0.t == m1.t);
+
+  shf::Hash hv;
+  REQUIRE(parallel.VerifyShuffle(ctxts, p1, hv));
+
+  // a tampered proof is rejected by the parallel verifier as well.
+  auto bad = p1;
+  bad.multiexp_proof.a[n / 2] += shf::Scalar::CreateFromInt(1);
+  shf::Hash hb;
+  REQUIRE_FALSE(parallel.VerifyShuffle(ctxts, bad, hb));
+}
+
+TEST_CASE("shuffle with tree hashing and sha256") {
+  shf::CurveInit();
+
+  const std::size_t n = 20;
+  const auto ck = shf::CreateCommitKey(n);
+  const auto sk = shf::CreateSecretKey();
+  const auto pk = shf::CreatePublicKey(sk);
+
+  std::vector<shf::Ctxt> ctxts;
+  for (std::size_t i = 0; i < n; ++i)
+    ctxts.emplace_back(shf::Encrypt(pk, shf::Point::CreateRandom()));
+
+  shf::Prg prg;
+  shf::ThreadPool pool(4);
+  shf::Shuffler tree(shf::FixedBasePoint(pk), ck, prg, &pool);
+  tree.SetListHashing(shf::ListHashing::kTree);
+  shf::Hash hp;
+  const auto proof = tree.Shuffle(ctxts, hp);
+
+  shf::Hash hv;
+  REQUIRE(tree.VerifyShuffle(ctxts, proof, hv));
+  std::vector<shf::Hash> hs(1);
+  REQUIRE(tree.BatchVerifyShuffles({ctxts}, {proof}, hs));
+
+  // the mode is part of the transcript.
+  shf::Shuffler sequential(pk, ck, prg);
+  shf::Hash hs0;
+  REQUIRE_FALSE(sequential.VerifyShuffle(ctxts, proof, hs0));
+
+  // so is the hash backend, which the proof records.
+  shf::Hash hp1(shf::HashBackend::kSha256);
+  const auto sha_proof = tree.Shuffle(ctxts, hp1);
+  REQUIRE(sha_proof.hash_backend == shf::HashBackend::kSha256);
+  shf::Hash hv1(shf::HashBackend::kSha256);
+  REQUIRE(tree.VerifyShuffle(ctxts, sha_proof, hv1));
+  shf::Hash hv2;
+  REQUIRE_FALSE(tree.VerifyShuffle(ctxts, sha_proof, hv2));
+}
+
+TEST_CASE("batch verify shuffles") {
+  shf::CurveInit();
+
+  const std::size_t n = 10;
+  const std::size_t m = 4;
+  const auto ck = shf::CreateCommitKey(n);
+  const auto sk = shf::CreateSecretKey();
+  const auto pk = shf::CreatePublicKey(sk);
+
+  shf::Prg prg;
+  shf::Shuffler shuffler(pk, ck, prg);
+
+  std::vector<std::vector<shf::Ctxt>> ctxt_lists(m);
+  std::vector<shf::ShuffleP> proofs;
+  for (auto& ctxts : ctxt_lists) {
+    for (std::size_t i = 0; i < n; ++i)
+      ctxts.emplace_back(shf::Encrypt(pk, shf::Point::CreateRandom()));
+    shf::Hash hp;
+    proofs.emplace_back(shuffler.Shuffle(ctxts, hp));
+  }
+
+  std::vector<std::size_t> invalid = {42};
+  std::vector<shf::Hash> hashes(m);
+  REQUIRE(shuffler.BatchVerifyShuffles(ctxt_lists, proofs, hashes, &invalid));
+  REQUIRE(invalid.empty());
+
+  SECTION("with a thread pool") {
+    shf::ThreadPool pool(4);
+    shf::Shuffler parallel(pk, ck, prg, pool);
+    std::vector<shf::Hash> hs(m);
+    REQUIRE(parallel.BatchVerifyShuffles(ctxt_lists, proofs, hs));
+  }
+
+  SECTION("finds the invalid proofs") {
+    auto bad = proofs;
+    bad[1].product_proof.r += shf::Scalar::CreateFromInt(1);
+    bad[3].multiexp_proof.E.V += shf::Point::Generator();
+    std::vector<shf::Hash> hs(m);
+    REQUIRE_FALSE(shuffler.BatchVerifyShuffles(ctxt_lists, bad, hs));
+    std::vector<shf::Hash> hs2(m);
+    REQUIRE_FALSE(shuffler.BatchVerifyShuffles(ctxt_lists, bad, hs2, &invalid));
+    REQUIRE(invalid == std::vector<std::size_t>{1, 3});
+  }
+
+  SECTION("malformed proofs") {
+    auto bad = proofs;
+    bad[2].permuted.pop_back();
+    std::vector<shf::Hash> hs(m);
+    REQUIRE_FALSE(shuffler.BatchVerifyShuffles(ctxt_lists, bad, hs, &invalid));
+    REQUIRE(invalid == std::vector<std::size_t>{2});
+
+    std::vector<shf::Hash> too_few(m - 1);
+    REQUIRE_THROWS_AS(shuffler.BatchVerifyShuffles(ctxt_lists, proofs, too_few),
+                      std::invalid_argument);
+  }
+}
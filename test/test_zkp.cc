@@ -55,6 +55,69 @@ TEST_CASE("dlogeq") {
   }
 }
 
+TEST_CASE("dlog batch") {
+  shf::CurveInit();
+
+  // the first half of the statements share a base.
+  const std::size_t n = 40;
+  const shf::Point G = shf::Point::Generator();
+  std::vector<shf::DLogS> stmts;
+  std::vector<shf::DLogP> proofs;
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto x = shf::Scalar::CreateRandom();
+    const auto B = i < n / 2 ? G : shf::Point::CreateRandom();
+    stmts.push_back({B, x * B});
+    shf::Hash hp;
+    proofs.emplace_back(shf::CreateProof(stmts.back(), hp, x));
+  }
+
+  std::vector<shf::Hash> hashes(n);
+  REQUIRE(shf::BatchVerify(stmts, proofs, hashes));
+  REQUIRE(shf::DigestEquals(hashes[3].Finalize(), [&] {
+    shf::Hash h;
+    shf::VerifyProof(stmts[3], h, proofs[3]);
+    return h.Finalize();
+  }()));
+
+  shf::ThreadPool pool(4);
+  std::vector<shf::Hash> hs(n);
+  REQUIRE(shf::BatchVerify(stmts, proofs, hs, &pool));
+
+  auto bad = proofs;
+  bad[n - 1].r += shf::Scalar::CreateFromInt(1);
+  std::vector<shf::Hash> hb(n);
+  REQUIRE_FALSE(shf::BatchVerify(stmts, bad, hb));
+
+  std::vector<shf::Hash> too_few(n - 1);
+  REQUIRE_THROWS_AS(shf::BatchVerify(stmts, proofs, too_few),
+                    std::invalid_argument);
+}
+
+TEST_CASE("dlogeq batch") {
+  shf::CurveInit();
+
+  const std::size_t n = 30;
+  const shf::Point G = shf::Point::Generator();
+  const shf::Point H = shf::Point::CreateRandom();
+  std::vector<shf::DLogEqS> stmts;
+  std::vector<shf::DLogEqP> proofs;
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto x = shf::Scalar::CreateRandom();
+    stmts.push_back({G, x * G, H, x * H});
+    shf::Hash hp;
+    proofs.emplace_back(shf::CreateProof(stmts.back(), hp, x));
+  }
+
+  std::vector<shf::Hash> hashes(n);
+  REQUIRE(shf::BatchVerify(stmts, proofs, hashes));
+
+  // a proof that only holds for one of the two bases.
+  auto bad = proofs;
+  bad[5].K += G;
+  std::vector<shf::Hash> hb(n);
+  REQUIRE_FALSE(shf::BatchVerify(stmts, bad, hb));
+}
+
 TEST_CASE("product") {
   shf::CurveInit();
 
@@ -74,6 +137,19 @@ TEST_CASE("product") {
     shf::Hash hp, hv;
     shf::ProductP proof = shf::CreateProof(ck, hp, {Cr.C, p}, a, Cr.r);
     REQUIRE(shf::VerifyProof(ck, hv, {Cr.C, p}, proof));
+
+    // every equation is part of the combined check.
+    const auto one = shf::Scalar::CreateFromInt(1);
+    auto bad0 = proof;
+    bad0.r += one;
+    shf::Hash h0;
+    REQUIRE_FALSE(shf::VerifyProof(ck, h0, {Cr.C, p}, bad0));
+    auto bad1 = proof;
+    bad1.s += one;
+    shf::Hash h1;
+    REQUIRE_FALSE(shf::VerifyProof(ck, h1, {Cr.C, p}, bad1));
+    shf::Hash h2;
+    REQUIRE_FALSE(shf::VerifyProof(ck, h2, {Cr.C, p + one}, proof));
   }
 }
 
@@ -115,5 +191,20 @@ TEST_CASE("multiexp") {
 
     shf::Hash hv;
     REQUIRE(shf::VerifyProof(ck, pk, hv, {Es, E, Car.C}, proof));
+
+    // every equation is part of the combined check.
+    const auto one = shf::Scalar::CreateFromInt(1);
+    auto bad0 = proof;
+    bad0.r += one;
+    shf::Hash h0;
+    REQUIRE_FALSE(shf::VerifyProof(ck, pk, h0, {Es, E, Car.C}, bad0));
+    auto bad1 = proof;
+    bad1.t += one;
+    shf::Hash h1;
+    REQUIRE_FALSE(shf::VerifyProof(ck, pk, h1, {Es, E, Car.C}, bad1));
+    auto bad2 = proof;
+    bad2.b += one;
+    shf::Hash h2;
+    REQUIRE_FALSE(shf::VerifyProof(ck, pk, h2, {Es, E, Car.C}, bad2));
   }
 }